@@ -0,0 +1,313 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ import streams.ByteStream;
+ 
+ 
+ /**
+  * This class codes segments of bits either with the <code>ArithmeticCoder</code> or raw
+  * (bypass), deciding for each segment from the data. Before coding a segment, the encoder
+  * estimates its MQ cost with <code>ArithmeticCoder.estimateCost</code> and compares it with the
+  * raw cost of 1 bit per bit; when the gain is below a threshold, the segment is written raw, so
+  * nearly incompressible data does not spend cycles in the arithmetic coder. The decision is
+  * signalled with one arithmetic coded flag per segment, with its own adaptive context for each
+  * group of segments (e.g., a coding pass or a group of contexts), so regular decisions cost
+  * almost nothing. The contexts of bypassed bits are not updated.<br>
+  *
+  * Raw bits are written MSB first in a separate segment with bit stuffing: a byte that follows
+  * 0xFF carries only 7 bits, with its most significant bit set to 0, and a 0 byte is appended when
+  * the segment ends with 0xFF, so that no marker is formed with the next bytes. The raw segment is
+  * placed before the arithmetic coded bytes, preceded by its length (see
+  * <code>SegmentLength</code>).<br>
+  *
+  * Usage: the coder (with the flag contexts reserved) is given at creation. The encoder calls
+  * <code>restartEncoding</code>, <code>encodeSegment</code> for each segment and
+  * <code>terminate</code>; other bits can be coded directly with the arithmetic coder in between.
+  * The decoder calls <code>restartDecoding</code> and <code>decodeSegment</code> for the same
+  * segments. The contexts are not reset by this class.<br>
+  *
+  * Multithreading support: the object must be created and manipulated by a single thread. There
+  * can be many objects of this class running simultaneously as long as a single thread manipulates
+  * each object.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class AdaptiveBypassCoder{
+ 
+   /**
+    * Default minimum gain of the arithmetic coder to code a segment with it.
+    * <p>
+    * In 1/256 of the raw cost (about 5%).
+    */
+   public static final int DEFAULT_MIN_GAIN = 13;
+ 
+   /**
+    * Arithmetic coder employed for the flags and the segments that are not bypassed.
+    * <p>
+    * Set when the class is instantiated.
+    */
+   private ArithmeticCoder coder;
+ 
+   /**
+    * Context of the flag of the first group of segments.
+    * <p>
+    * Group g employs the context firstFlagContext + g.
+    */
+   private int firstFlagContext;
+ 
+   /**
+    * Minimum gain of the arithmetic coder to code a segment with it.
+    * <p>
+    * In 1/256 of the raw cost.
+    */
+   private int minGain;
+ 
+   /**
+    * Stream of the arithmetic coded bytes (for encoding purposes).
+    * <p>
+    * Copied to the output stream by <code>terminate</code>.
+    */
+   private ByteStream mqStream = new ByteStream();
+ 
+   /**
+    * Stream of the raw bytes (for encoding purposes).
+    * <p>
+    * Copied to the output stream by <code>terminate</code>.
+    */
+   private ByteStream rawStream = new ByteStream();
+ 
+   /**
+    * Stream from which the raw bytes are read (for decoding purposes).
+    * <p>
+    * Set with <code>restartDecoding</code>.
+    */
+   private ByteStream rawInput = null;
+ 
+   /**
+    * Raw byte being written or read.
+    * <p>
+    * Bits are written and read from the most significant one.
+    */
+   private int rawByte;
+ 
+   /**
+    * Number of bits of <code>rawByte</code> not written or read yet.
+    * <p>
+    * In the range [0, 8].
+    */
+   private int rawFree;
+ 
+   /**
+    * Number of bits of <code>rawByte</code>.
+    * <p>
+    * 7 after a 0xFF byte, 8 otherwise.
+    */
+   private int rawCapacity;
+ 
+   /**
+    * Position of the next raw byte read (for decoding purposes).
+    * <p>
+    * Bytes from <code>rawEnd</code> onwards are read as 0.
+    */
+   private int rawPosition;
+ 
+   /**
+    * End of the raw segment (for decoding purposes).
+    * <p>
+    * Exclusive.
+    */
+   private int rawEnd;
+ 
+   /**
+    * Number of segments bypassed since the last restart.
+    * <p>
+    * For statistics.
+    */
+   private int numBypassed;
+ 
+ 
+   /**
+    * Creates the switching coder with the default minimum gain.
+    *
+    * @param coder arithmetic coder employed, whose contexts are shared with the caller
+    * @param firstFlagContext first context of the coder reserved for the flags, one per group of
+    * segments
+    */
+   public AdaptiveBypassCoder(ArithmeticCoder coder, int firstFlagContext){
+     this(coder, firstFlagContext, DEFAULT_MIN_GAIN);
+   }
+ 
+   /**
+    * Creates the switching coder.
+    *
+    * @param coder arithmetic coder employed, whose contexts are shared with the caller
+    * @param firstFlagContext first context of the coder reserved for the flags, one per group of
+    * segments
+    * @param minGain minimum gain of the arithmetic coder to code a segment with it, in 1/256 of
+    * the raw cost; 0 bypasses only the segments that the arithmetic coder would expand
+    */
+   public AdaptiveBypassCoder(ArithmeticCoder coder, int firstFlagContext, int minGain){
+     this.coder = coder;
+     this.firstFlagContext = firstFlagContext;
+     this.minGain = minGain;
+   }
+ 
+   /**
+    * Restarts the coder for encoding, including the arithmetic coder.
+    */
+   public void restartEncoding(){
+     mqStream.removeBytes((int) mqStream.getLength());
+     rawStream.removeBytes((int) rawStream.getLength());
+     coder.changeStream(mqStream);
+     coder.restartEncoding();
+     rawByte = 0;
+     rawFree = 8;
+     rawCapacity = 8;
+     numBypassed = 0;
+   }
+ 
+   /**
+    * Restarts the coder for decoding a segment of a stream written by <code>terminate</code>,
+    * including the arithmetic coder.
+    *
+    * @param stream stream from which the bits are read
+    * @param begin first byte of the segment (inclusive)
+    * @param end last byte of the segment (exclusive)
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void restartDecoding(ByteStream stream, int begin, int end) throws Exception{
+     rawInput = stream;
+     rawPosition = begin + SegmentLength.NUM_BYTES;
+     rawEnd = rawPosition + SegmentLength.read(stream, begin);
+     if(rawEnd > end){
+       throw new Exception("Wrong length of the raw segment.");
+     }
+     rawByte = 0;
+     rawFree = 0;
+     rawCapacity = 8;
+     numBypassed = 0;
+     coder.changeStream(stream);
+     coder.restartDecoding(rawEnd, end);
+   }
+ 
+   /**
+    * Encodes a segment of bits, either with the arithmetic coder or raw.
+    *
+    * @param group group of the segment, whose flag is coded in the context firstFlagContext + group
+    * @param bits input bits, either 0 or 1
+    * @param contexts context of each bit in the arithmetic coder
+    * @param length number of bits of the segment
+    */
+   public void encodeSegment(int group, int[] bits, int[] contexts, int length){
+     long rawCost = (long) length << ArithmeticCoder.COST_BITS;
+     long mqCost = coder.estimateCost(bits, contexts, length);
+     boolean bypass = ((rawCost - mqCost) << 8) < rawCost * minGain;
+     coder.encodeBitContext(bypass, firstFlagContext + group);
+     if(bypass){
+       numBypassed++;
+       for(int i = 0; i < length; i++){
+         putRawBit(bits[i]);
+       }
+     }else{
+       coder.encodeBitsContext(bits, contexts, length);
+     }
+   }
+ 
+   /**
+    * Decodes a segment of bits.
+    *
+    * @param group group of the segment, whose flag is coded in the context firstFlagContext + group
+    * @param contexts context of each bit in the arithmetic coder
+    * @param length number of bits of the segment
+    * @param bits array where the bits are stored, either 0 or 1
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void decodeSegment(int group, int[] contexts, int length, int[] bits) throws Exception{
+     if(coder.decodeBitContext(firstFlagContext + group)){
+       numBypassed++;
+       for(int i = 0; i < length; i++){
+         bits[i] = getRawBit();
+       }
+     }else{
+       for(int i = 0; i < length; i++){
+         bits[i] = coder.decodeBitContext(contexts[i]) ? 1: 0;
+       }
+     }
+   }
+ 
+   /**
+    * Gets the number of segments bypassed since the last restart.
+    *
+    * @return number of segments
+    */
+   public int getNumBypassed(){
+     return(numBypassed);
+   }
+ 
+   /**
+    * Terminates the arithmetic coder and the raw segment, and writes both to a stream (for
+    * encoding purposes).
+    *
+    * @param stream stream where the bytes are appended
+    * @throws Exception when the raw segment is too long or some problem manipulating the stream
+    * occurs
+    */
+   public void terminate(ByteStream stream) throws Exception{
+     coder.terminate();
+     if(rawFree < rawCapacity){
+       rawStream.putByte((byte) (rawByte << rawFree));
+     }else if(rawCapacity == 7){
+       //The last byte is 0xFF, and the arithmetic coded bytes that follow could form a marker
+       rawStream.putByte((byte) 0);
+     }
+     int rawLength = (int) rawStream.getLength();
+     SegmentLength.write(stream, rawLength);
+     for(int b = 0; b < rawLength; b++){
+       stream.putByte(rawStream.getByte(b));
+     }
+     for(int b = 0; b < (int) mqStream.getLength(); b++){
+       stream.putByte(mqStream.getByte(b));
+     }
+   }
+ 
+   /**
+    * Writes a raw bit, stuffing a 0 after each 0xFF byte (for encoding purposes).
+    *
+    * @param bit 0 or 1
+    */
+   private void putRawBit(int bit){
+     rawByte = (rawByte << 1) | bit;
+     rawFree--;
+     if(rawFree == 0){
+       rawStream.putByte((byte) rawByte);
+       rawCapacity = rawByte == 0xFF ? 7: 8;
+       rawFree = rawCapacity;
+       rawByte = 0;
+     }
+   }
+ 
+   /**
+    * Reads a raw bit (for decoding purposes).
+    *
+    * @return 0 or 1
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   private int getRawBit() throws Exception{
+     if(rawFree == 0){
+       rawCapacity = rawByte == 0xFF ? 7: 8;
+       rawByte = rawPosition < rawEnd ? rawInput.getByte(rawPosition++) & 0xFF: 0;
+       rawFree = rawCapacity;
+     }
+     rawFree--;
+     return((rawByte >> rawFree) & 1);
+   }
+ }
\ No newline at end of file
@@ -0,0 +1,141 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ 
+ /**
+  * This class implements an adaptive probability map (APM, also known as secondary symbol
+  * estimation) that refines a probability given a context. For each context, the stretch domain
+  * of the input probability is divided into 32 intervals whose 33 ends hold an output probability;
+  * the refined probability is interpolated between the two ends of the interval of the input, and
+  * the nearest end is moved towards the bit coded. Initially, each end outputs its input, so the
+  * map starts as the identity.<br>
+  *
+  * Probabilities are of the symbol 0, in 12 bits as in <code>LogisticMixer</code>; the ends are
+  * kept in 16 bits.<br>
+  *
+  * Usage: <code>refine</code> is called with the probability of a bit, and <code>update</code>
+  * after coding it. The refined probability is usually averaged with its input.<br>
+  *
+  * Multithreading support: the object must be created and manipulated by a single thread. There
+  * can be many objects of this class running simultaneously as long as a single thread manipulates
+  * each object.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class AdaptiveProbabilityMap{
+ 
+   /**
+    * Number of ends of the intervals of each context.
+    * <p>
+    * 32 intervals of 128 in the stretch domain.
+    */
+   private static final int NUM_ENDS = 33;
+ 
+   /**
+    * Default adaptation rate.
+    * <p>
+    * Each update moves the nearest end 1/128 of the way.
+    */
+   public static final int DEFAULT_RATE = 7;
+ 
+   /**
+    * Number of contexts.
+    * <p>
+    * Set when the class is instantiated.
+    */
+   private int numContexts;
+ 
+   /**
+    * Adaptation rate (shift).
+    * <p>
+    * In the range [1, 15].
+    */
+   private int rate;
+ 
+   /**
+    * Probabilities of the symbol 0 at the ends of the intervals of all contexts.
+    * <p>
+    * 16 bits.
+    */
+   private int[] ends;
+ 
+   /**
+    * End updated after coding the current bit.
+    * <p>
+    * Set with <code>refine</code>.
+    */
+   private int nearestEnd;
+ 
+ 
+   /**
+    * Creates the map with the default adaptation rate.
+    *
+    * @param numContexts number of contexts
+    */
+   public AdaptiveProbabilityMap(int numContexts){
+     this(numContexts, DEFAULT_RATE);
+   }
+ 
+   /**
+    * Creates the map.
+    *
+    * @param numContexts number of contexts
+    * @param rate adaptation rate, in the range [1, 15]; lower rates adapt faster
+    */
+   public AdaptiveProbabilityMap(int numContexts, int rate){
+     this.numContexts = numContexts;
+     this.rate = rate;
+     ends = new int[numContexts * NUM_ENDS];
+     reset();
+   }
+ 
+   /**
+    * Sets the map of all contexts to the identity.
+    */
+   public void reset(){
+     for(int c = 0; c < numContexts; c++){
+       for(int e = 0; e < NUM_ENDS; e++){
+         int x = (e - 16) * 128;
+         x = x < -LogisticMixer.MAX_STRETCH ? -LogisticMixer.MAX_STRETCH:
+           (x > LogisticMixer.MAX_STRETCH ? LogisticMixer.MAX_STRETCH: x);
+         ends[c * NUM_ENDS + e] = LogisticMixer.squash(x) << 4;
+       }
+     }
+     nearestEnd = 0;
+   }
+ 
+   /**
+    * Refines the probability of the current bit.
+    *
+    * @param prob0 probability of the symbol 0 in 12 bits
+    * @param context context of the bit
+    * @return refined probability of the symbol 0 in 12 bits, in the range [1, 4095]
+    */
+   public int refine(int prob0, int context){
+     int x = LogisticMixer.stretch(prob0) + 2048;
+     int weight = x & 127;
+     int end = context * NUM_ENDS + (x >> 7);
+     nearestEnd = end + (weight >> 6);
+     int refined = (ends[end] * (128 - weight) + ends[end + 1] * weight) >> 11;
+     return(refined < 1 ? 1: (refined > 4095 ? 4095: refined));
+   }
+ 
+   /**
+    * Moves the end nearest to the last probability refined towards the bit coded.
+    *
+    * @param bit bit coded
+    */
+   public void update(boolean bit){
+     int target = bit ? 0: 0xFFFF;
+     ends[nearestEnd] += (target - ends[nearestEnd]) >> rate;
+   }
+ }
\ No newline at end of file
@@ -0,0 +1,387 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ 
+ /**
+  * This class codes integers and multi-symbol values with the <code>ArithmeticCoder</code> through
+  * binarization: the value is converted into a sequence of binary decisions (bins), each one coded
+  * with its own context. The schemes available are:
+  * <ul>
+  * <li>unary: v bins 1 followed by a bin 0,
+  * <li>truncated unary: as unary, without the bin 0 when v is the maximum value,
+  * <li>exp-Golomb of order k: a unary prefix that selects a range of 2^(k + i) values and the
+  * offset within the range,
+  * <li>fixed width: the bits of the value, from the most significant one,
+  * <li>binary tree: the bits of a symbol, each one coded in the context of the bits coded before
+  * it (one context per node of the tree), so that any distribution of the symbols is learnt.
+  * </ul>
+  * Each scheme owns a sub-range of contexts, so the schemes do not interfere with each other. The
+  * sub-ranges are placed one after the other from a given offset of the contexts of the coder.<br>
+  *
+  * When encoding, the bins of a value are collected and coded with a single call to
+  * <code>encodeBitsContext</code>, which keeps the registers of the coder in local variables.<br>
+  *
+  * Multithreading support: the object must be created and manipulated by a single thread. There
+  * can be many objects of this class running simultaneously as long as a single thread manipulates
+  * each object.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class Binarizer{
+ 
+   /**
+    * Number of contexts of the unary and the truncated unary schemes.
+    * <p>
+    * The bin i employs the context min(i, UNARY_CONTEXTS - 1).
+    */
+   public static final int UNARY_CONTEXTS = 16;
+ 
+   /**
+    * Number of contexts of the prefix and of the suffix of the exp-Golomb scheme.
+    * <p>
+    * The prefix bin i employs the context min(i, EXP_GOLOMB_CONTEXTS - 1) and the suffix bit b
+    * the context EXP_GOLOMB_CONTEXTS + b.
+    */
+   public static final int EXP_GOLOMB_CONTEXTS = 32;
+ 
+   /**
+    * Number of contexts of the fixed-width scheme.
+    * <p>
+    * The bit b employs the context b.
+    */
+   public static final int FIXED_CONTEXTS = 31;
+ 
+   /**
+    * Maximum number of bins collected before calling the coder.
+    * <p>
+    * Longer values are coded with several calls.
+    */
+   private static final int MAX_BINS = 64;
+ 
+   /**
+    * First context of the unary scheme in the <code>ArithmeticCoder</code>.
+    * <p>
+    * Equal to the offset given in the constructor.
+    */
+   private int unaryOffset;
+ 
+   /**
+    * First context of the truncated unary scheme.
+    * <p>
+    * Set in the constructor.
+    */
+   private int truncatedUnaryOffset;
+ 
+   /**
+    * First context of the exp-Golomb scheme.
+    * <p>
+    * Set in the constructor.
+    */
+   private int expGolombOffset;
+ 
+   /**
+    * First context of the fixed-width scheme.
+    * <p>
+    * Set in the constructor.
+    */
+   private int fixedOffset;
+ 
+   /**
+    * First context of the binary tree scheme.
+    * <p>
+    * Set in the constructor.
+    */
+   private int treeOffset;
+ 
+   /**
+    * Number of bits of the symbols of the binary tree scheme.
+    * <p>
+    * The tree has 2^treeBits contexts.
+    */
+   private int treeBits;
+ 
+   /**
+    * Bins collected (for encoding purposes).
+    * <p>
+    * Coded with <code>encodeBitsContext</code>.
+    */
+   private int[] bins = new int[MAX_BINS];
+ 
+   /**
+    * Context of each bin in <code>bins</code>.
+    * <p>
+    * Absolute contexts of the coder.
+    */
+   private int[] binContexts = new int[MAX_BINS];
+ 
+ 
+   /**
+    * Creates the binarizer.
+    *
+    * @param contextOffset first context employed in the <code>ArithmeticCoder</code>
+    * @param treeBits number of bits of the symbols of the binary tree scheme, in the range [0, 30]
+    */
+   public Binarizer(int contextOffset, int treeBits){
+     this.treeBits = treeBits;
+     unaryOffset = contextOffset;
+     truncatedUnaryOffset = unaryOffset + UNARY_CONTEXTS;
+     expGolombOffset = truncatedUnaryOffset + UNARY_CONTEXTS;
+     fixedOffset = expGolombOffset + 2 * EXP_GOLOMB_CONTEXTS;
+     treeOffset = fixedOffset + FIXED_CONTEXTS;
+   }
+ 
+   /**
+    * Gets the number of contexts employed, from the offset given in the constructor.
+    *
+    * @return number of contexts
+    */
+   public int getNumContexts(){
+     return(treeOffset + ArithmeticCoder.BIT_MASKS[treeBits] - unaryOffset);
+   }
+ 
+   /**
+    * Encodes a value with the unary scheme.
+    *
+    * @param coder coder employed
+    * @param value value to encode (non-negative)
+    */
+   public void encodeUnary(BinaryCoder coder, int value){
+     encodeUnary(coder, value, unaryOffset, true);
+   }
+ 
+   /**
+    * Decodes a value coded with the unary scheme.
+    *
+    * @param coder coder employed
+    * @return the value decoded
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public int decodeUnary(BinaryCoder coder) throws Exception{
+     return(decodeUnary(coder, unaryOffset, Integer.MAX_VALUE));
+   }
+ 
+   /**
+    * Encodes a value with the truncated unary scheme.
+    *
+    * @param coder coder employed
+    * @param value value to encode, in the range [0, maxValue]
+    * @param maxValue maximum value
+    */
+   public void encodeTruncatedUnary(BinaryCoder coder, int value, int maxValue){
+     encodeUnary(coder, value, truncatedUnaryOffset, value < maxValue);
+   }
+ 
+   /**
+    * Decodes a value coded with the truncated unary scheme.
+    *
+    * @param coder coder employed
+    * @param maxValue maximum value
+    * @return the value decoded
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public int decodeTruncatedUnary(BinaryCoder coder, int maxValue) throws Exception{
+     return(decodeUnary(coder, truncatedUnaryOffset, maxValue));
+   }
+ 
+   /**
+    * Encodes a value with the exp-Golomb scheme.
+    *
+    * @param coder coder employed
+    * @param value value to encode, in the range [0, 2^30 - 1]
+    * @param order order of the code (k), in the range [0, 30]
+    */
+   public void encodeExpGolomb(BinaryCoder coder, int value, int order){
+     int n = 0;
+     int prefixContext = expGolombOffset;
+     while(value >= ArithmeticCoder.BIT_MASKS[order]){
+       value -= ArithmeticCoder.BIT_MASKS[order];
+       order++;
+       bins[n] = 1;
+       binContexts[n++] = prefixContext;
+       if(n < EXP_GOLOMB_CONTEXTS){
+         prefixContext++;
+       }
+     }
+     bins[n] = 0;
+     binContexts[n++] = prefixContext;
+     int suffixOffset = expGolombOffset + EXP_GOLOMB_CONTEXTS;
+     for(int b = order - 1; b >= 0; b--){
+       bins[n] = (value & ArithmeticCoder.BIT_MASKS[b]) != 0 ? 1: 0;
+       binContexts[n++] = suffixOffset + b;
+     }
+     coder.encodeBitsContext(bins, binContexts, n);
+   }
+ 
+   /**
+    * Decodes a value coded with the exp-Golomb scheme.
+    *
+    * @param coder coder employed
+    * @param order order of the code (k)
+    * @return the value decoded
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public int decodeExpGolomb(BinaryCoder coder, int order) throws Exception{
+     int value = 0;
+     int prefix = 0;
+     int prefixContext = expGolombOffset;
+     while(coder.decodeBitContext(prefixContext)){
+       value += ArithmeticCoder.BIT_MASKS[order];
+       order++;
+       prefix++;
+       if(prefix < EXP_GOLOMB_CONTEXTS){
+         prefixContext++;
+       }
+     }
+     int suffixOffset = expGolombOffset + EXP_GOLOMB_CONTEXTS;
+     int suffix = 0;
+     for(int b = order - 1; b >= 0; b--){
+       suffix = (suffix << 1) | (coder.decodeBitContext(suffixOffset + b) ? 1: 0);
+     }
+     return(value + suffix);
+   }
+ 
+   /**
+    * Encodes a value with the fixed-width scheme.
+    *
+    * @param coder coder employed
+    * @param value value to encode, in the range [0, 2^numBits - 1]
+    * @param numBits number of bits of the value, in the range [0, FIXED_CONTEXTS]
+    */
+   public void encodeFixed(BinaryCoder coder, int value, int numBits){
+     for(int b = numBits - 1, n = 0; b >= 0; b--, n++){
+       bins[n] = (value & ArithmeticCoder.BIT_MASKS[b]) != 0 ? 1: 0;
+       binContexts[n] = fixedOffset + b;
+     }
+     coder.encodeBitsContext(bins, binContexts, numBits);
+   }
+ 
+   /**
+    * Decodes a value coded with the fixed-width scheme.
+    *
+    * @param coder coder employed
+    * @param numBits number of bits of the value
+    * @return the value decoded
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public int decodeFixed(BinaryCoder coder, int numBits) throws Exception{
+     int value = 0;
+     int b = numBits - 1;
+     //Four bits per iteration
+     for(; b >= 3; b -= 4){
+       if(coder.decodeBitContext(fixedOffset + b)){
+         value |= ArithmeticCoder.BIT_MASKS[b];
+       }
+       if(coder.decodeBitContext(fixedOffset + b - 1)){
+         value |= ArithmeticCoder.BIT_MASKS[b - 1];
+       }
+       if(coder.decodeBitContext(fixedOffset + b - 2)){
+         value |= ArithmeticCoder.BIT_MASKS[b - 2];
+       }
+       if(coder.decodeBitContext(fixedOffset + b - 3)){
+         value |= ArithmeticCoder.BIT_MASKS[b - 3];
+       }
+     }
+     for(; b >= 0; b--){
+       if(coder.decodeBitContext(fixedOffset + b)){
+         value |= ArithmeticCoder.BIT_MASKS[b];
+       }
+     }
+     return(value);
+   }
+ 
+   /**
+    * Encodes a symbol with the binary tree scheme.
+    *
+    * @param coder coder employed
+    * @param symbol symbol to encode, in the range [0, 2^treeBits - 1]
+    */
+   public void encodeTree(BinaryCoder coder, int symbol){
+     int node = 1;
+     for(int b = treeBits - 1, n = 0; b >= 0; b--, n++){
+       int bit = (symbol >> b) & 1;
+       bins[n] = bit;
+       binContexts[n] = treeOffset + node;
+       node = (node << 1) | bit;
+     }
+     coder.encodeBitsContext(bins, binContexts, treeBits);
+   }
+ 
+   /**
+    * Decodes a symbol coded with the binary tree scheme.
+    *
+    * @param coder coder employed
+    * @return the symbol decoded
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public int decodeTree(BinaryCoder coder) throws Exception{
+     int node = 1;
+     for(int b = treeBits; b > 0; b--){
+       node = (node << 1) | (coder.decodeBitContext(treeOffset + node) ? 1: 0);
+     }
+     return(node - ArithmeticCoder.BIT_MASKS[treeBits]);
+   }
+ 
+   /**
+    * Encodes a value with the unary scheme in a sub-range of contexts.
+    *
+    * @param coder coder employed
+    * @param value value to encode (non-negative)
+    * @param contextOffset first context of the sub-range
+    * @param terminate true to code the bin 0 after the bins 1
+    */
+   private void encodeUnary(BinaryCoder coder, int value, int contextOffset, boolean terminate){
+     int n = 0;
+     for(int i = 0; i < value; i++){
+       if(n == MAX_BINS){
+         coder.encodeBitsContext(bins, binContexts, n);
+         n = 0;
+       }
+       bins[n] = 1;
+       binContexts[n++] = contextOffset + (i < UNARY_CONTEXTS ? i: UNARY_CONTEXTS - 1);
+     }
+     if(terminate){
+       if(n == MAX_BINS){
+         coder.encodeBitsContext(bins, binContexts, n);
+         n = 0;
+       }
+       bins[n] = 0;
+       binContexts[n++] = contextOffset + (value < UNARY_CONTEXTS ? value: UNARY_CONTEXTS - 1);
+     }
+     coder.encodeBitsContext(bins, binContexts, n);
+   }
+ 
+   /**
+    * Decodes a value coded with the unary scheme in a sub-range of contexts.
+    *
+    * @param coder coder employed
+    * @param contextOffset first context of the sub-range
+    * @param maxValue maximum value (no bin 0 follows it)
+    * @return the value decoded
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   private int decodeUnary(BinaryCoder coder, int contextOffset, int maxValue) throws Exception{
+     int value = 0;
+     int lastContext = contextOffset + UNARY_CONTEXTS - 1;
+     //Bins with their own context
+     while((value < UNARY_CONTEXTS - 1) && (value < maxValue)){
+       if(!coder.decodeBitContext(contextOffset + value)){
+         return(value);
+       }
+       value++;
+     }
+     //Bins sharing the last context
+     while((value < maxValue) && coder.decodeBitContext(lastContext)){
+       value++;
+     }
+     return(value);
+   }
+ }
\ No newline at end of file
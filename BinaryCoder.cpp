@@ -0,0 +1,112 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ import streams.ByteStream;
+ 
+ 
+ /**
+  * This interface is implemented by the binary entropy coders with adaptive contexts, so that the
+  * models that code their symbols through it (e.g., <code>Binarizer</code>,
+  * <code>IntegerCoder</code> or <code>GenericRegionCoder</code>) can employ the MQ coder
+  * (<code>ArithmeticCoder</code>), the rANS coder (<code>RANSCoder</code>) or the CABAC coder
+  * (<code>CABACCoder</code>) without changes. The probabilities of the contexts follow the state
+  * machine of the MQ coder except in <code>CABACCoder</code>, which has its own 64 states.<br>
+  *
+  * Multithreading support: see the implementations.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public interface BinaryCoder{
+ 
+   /**
+    * Changes the current stream.
+    *
+    * @param stream the new ByteStream
+    */
+   void changeStream(ByteStream stream);
+ 
+   /**
+    * Resets the state of all contexts.
+    */
+   void reset();
+ 
+   /**
+    * Restarts the internal registers of the coder for encoding. Bytes are appended to the stream.
+    */
+   void restartEncoding();
+ 
+   /**
+    * Restarts the internal registers of the coder for decoding the whole stream.
+    *
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   void restartDecoding() throws Exception;
+ 
+   /**
+    * Restarts the internal registers of the coder for decoding a segment of the stream.
+    *
+    * @param begin first byte of the segment (inclusive)
+    * @param end last byte of the segment (exclusive)
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   void restartDecoding(int begin, int end) throws Exception;
+ 
+   /**
+    * Encodes a bit using a context.
+    *
+    * @param bit input
+    * @param context context of the symbol
+    */
+   void encodeBitContext(boolean bit, int context);
+ 
+   /**
+    * Encodes a sequence of bits, each one with its own context.
+    *
+    * @param bits input bits, either 0 or 1
+    * @param contexts context of each bit
+    * @param length number of bits to encode
+    */
+   void encodeBitsContext(int[] bits, int[] contexts, int length);
+ 
+   /**
+    * Decodes a bit using a context.
+    *
+    * @param context context of the symbol
+    * @return output bit
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   boolean decodeBitContext(int context) throws Exception;
+ 
+   /**
+    * Encodes a bit using a specified probability (see <code>ArithmeticCoder.encodeBitProb</code>).
+    *
+    * @param bit input
+    * @param prob0 probability of the symbol 0, as given by <code>ArithmeticCoder.prob0ToMQ</code>
+    */
+   void encodeBitProb(boolean bit, int prob0);
+ 
+   /**
+    * Decodes a bit using a specified probability.
+    *
+    * @param prob0 probability of the symbol 0, as given by <code>ArithmeticCoder.prob0ToMQ</code>
+    * @return output bit
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   boolean decodeBitProb(int prob0) throws Exception;
+ 
+   /**
+    * Terminates the current stream (for encoding purposes).
+    *
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   void terminate() throws Exception;
+ }
\ No newline at end of file
@@ -0,0 +1,89 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ import streams.ByteStream;
+ 
+ 
+ /**
+  * This interface is implemented by the coders of code-blocks, so that the bit-plane coder based on
+  * the <code>ArithmeticCoder</code> (<code>Tier1Coder</code>) and the high-throughput coder
+  * (<code>HTBlockCoder</code>) can be interchanged.<br>
+  *
+  * Multithreading support: see the implementations.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public interface BlockCoder{
+ 
+   /**
+    * Sets the coding options employed for the next code-blocks. The decoder must employ the same
+    * options as the encoder.
+    *
+    * @param options combination of options of the implementation, or 0 for none
+    */
+   void setOptions(int options);
+ 
+   /**
+    * Encodes a code-block.
+    *
+    * @param samples samples of the code-block, row by row, in two's complement
+    * @param width width of the code-block
+    * @param height height of the code-block
+    * @param subband subband to which the code-block belongs (one of the <code>SUBBAND_*</code>
+    * constants of <code>Tier1Coder</code>)
+    * @param stream stream where the code-block is written, from its first byte (the previous
+    * content of the stream is removed)
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   void encode(int[] samples, int width, int height, int subband, ByteStream stream) throws Exception;
+ 
+   /**
+    * Decodes a code-block. Bits of the bit planes not decoded are set to 0. The code-block must
+    * begin at the first byte of the stream.
+    *
+    * @param stream stream from which the code-block is read
+    * @param width width of the code-block
+    * @param height height of the code-block
+    * @param subband subband to which the code-block belongs
+    * @param numBitPlanes number of magnitude bit planes of the code-block
+    * @param numPasses number of coding passes to decode
+    * @param passEnds end of each coding pass in the stream, as given by <code>getPassEnds</code>
+    * when encoding. It can be null when the implementation does not need it
+    * @param samples array where the samples are stored, row by row, in two's complement
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   void decode(ByteStream stream, int width, int height, int subband, int numBitPlanes,
+   int numPasses, int[] passEnds, int[] samples) throws Exception;
+ 
+   /**
+    * Gets the number of magnitude bit planes of the last code-block coded.
+    *
+    * @return number of bit planes
+    */
+   int getNumBitPlanes();
+ 
+   /**
+    * Gets the number of coding passes of the last code-block coded.
+    *
+    * @return number of coding passes
+    */
+   int getNumPasses();
+ 
+   /**
+    * Gets the end of each coding pass of the last code-block encoded, in bytes from the beginning
+    * of the code-block.
+    *
+    * @return array whose first <code>getNumPasses()</code> positions are valid. It is overwritten
+    * when the next code-block is encoded
+    */
+   int[] getPassEnds();
+ }
\ No newline at end of file
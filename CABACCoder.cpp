@@ -0,0 +1,461 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ import streams.ByteStream;
+ 
+ 
+ /**
+  * This class implements a table-driven binary arithmetic coder as the one of CABAC (the M coder of
+  * H.264/AVC, ITU-T H.264 section 9.3). The range is kept in a 9-bit register and the sub-range of
+  * the least probable symbol is looked up in a table indexed by the state of the context and by 2
+  * bits of the range, so no multiplication is needed. Each context has 64 probability states
+  * (63 employed) spread on a logarithmic scale from 0.5 to about 0.02, which gives a finer
+  * resolution of the probabilities than the 47 states of the MQ coder, and there is no
+  * conditional exchange.<br>
+  *
+  * The encoder writes single bits, resolving carries with the count of outstanding bits of the
+  * standard. The decoder renormalizes with all the bits needed at once, taken from a bit buffer
+  * that is refilled a byte at a time.<br>
+  *
+  * Usage: as the <code>ArithmeticCoder</code>.<br>
+  *
+  * Multithreading support: the object must be created and manipulated by a single thread. There
+  * can be many objects of this class running simultaneously as long as a single thread manipulates
+  * each object.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class CABACCoder implements BinaryCoder{
+ 
+   /**
+    * Sub-range of the least probable symbol.
+    * <p>
+    * Indexed as [state][(range >> 6) & 3] (rangeTabLPS of the standard).
+    */
+   private static final int[][] RANGE_LPS = {
+     {128, 176, 208, 240}, {128, 167, 197, 227}, {128, 158, 187, 216}, {123, 150, 178, 205},
+     {116, 142, 169, 195}, {111, 135, 160, 185}, {105, 128, 152, 175}, {100, 122, 144, 166},
+     {95, 116, 137, 158}, {90, 110, 130, 150}, {85, 104, 123, 142}, {81, 99, 117, 135},
+     {77, 94, 111, 128}, {73, 89, 105, 122}, {69, 85, 100, 116}, {66, 80, 95, 110},
+     {62, 76, 90, 104}, {59, 72, 86, 99}, {56, 69, 81, 94}, {53, 65, 77, 89},
+     {51, 62, 73, 85}, {48, 59, 69, 80}, {46, 56, 66, 76}, {43, 53, 63, 72},
+     {41, 50, 59, 69}, {39, 48, 56, 65}, {37, 45, 54, 62}, {35, 43, 51, 59},
+     {33, 41, 48, 56}, {32, 39, 46, 53}, {30, 37, 43, 50}, {29, 35, 41, 48},
+     {27, 33, 39, 45}, {26, 31, 37, 43}, {24, 30, 35, 41}, {23, 28, 33, 39},
+     {22, 27, 32, 37}, {21, 26, 30, 35}, {20, 24, 29, 33}, {19, 23, 27, 31},
+     {18, 22, 26, 30}, {17, 21, 25, 28}, {16, 20, 23, 27}, {15, 19, 22, 25},
+     {14, 18, 21, 24}, {14, 17, 20, 23}, {13, 16, 19, 22}, {12, 15, 18, 21},
+     {12, 14, 17, 20}, {11, 14, 16, 19}, {11, 13, 15, 18}, {10, 12, 15, 17},
+     {10, 12, 14, 16}, {9, 11, 13, 15}, {9, 11, 12, 14}, {8, 10, 12, 14},
+     {8, 9, 11, 13}, {7, 9, 11, 12}, {7, 9, 10, 12}, {7, 8, 10, 11},
+     {6, 8, 9, 11}, {6, 7, 9, 10}, {6, 7, 8, 9}, {2, 2, 2, 2}};
+ 
+   /**
+    * Transition to the next state when coding the least probable symbol.
+    * <p>
+    * transIdxLPS of the standard.
+    */
+   private static final int[] TRANSITIONS_LPS = {0, 0, 1, 2, 2, 4, 4, 5, 6, 7, 8, 9, 9, 11,
+     11, 12, 13, 13, 15, 15, 16, 16, 18, 18, 19, 19, 21, 21, 22, 22, 23, 24, 24, 25, 26, 26,
+     27, 27, 28, 29, 29, 30, 30, 30, 31, 32, 32, 33, 33, 33, 34, 34, 35, 35, 35, 36, 36, 36,
+     37, 37, 37, 38, 38, 63};
+ 
+   /**
+    * Transition to the next state when coding the most probable symbol.
+    * <p>
+    * transIdxMPS of the standard.
+    */
+   private static final int[] TRANSITIONS_MPS = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+     15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36,
+     37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58,
+     59, 60, 61, 62, 62, 63};
+ 
+   /**
+    * ByteStream employed to write or read the bytes.
+    * <p>
+    * Set with <code>changeStream</code>.
+    */
+   private ByteStream stream = null;
+ 
+   /**
+    * Number of contexts.
+    * <p>
+    * Set when the class is instantiated.
+    */
+   private int numContexts;
+ 
+   /**
+    * Current state of each context.
+    * <p>
+    * In the range [0, 62].
+    */
+   private int[] contextState;
+ 
+   /**
+    * Most probable symbol of each context.
+    * <p>
+    * Either 0 or 1.
+    */
+   private int[] contextMPS;
+ 
+   /**
+    * Size of the interval (codIRange).
+    * <p>
+    * 9 bits, in the range [256, 510] between symbols.
+    */
+   private int range;
+ 
+   /**
+    * Lower end of the interval (codILow, for encoding purposes) or position of the codeword in the
+    * interval (codIOffset, for decoding purposes).
+    * <p>
+    * 10 bits when encoding, 9 bits when decoding.
+    */
+   private int low;
+ 
+   /**
+    * Indicates that the next bit written is the first one, which is not output (for encoding
+    * purposes).
+    * <p>
+    * firstBitFlag of the standard.
+    */
+   private boolean firstBit;
+ 
+   /**
+    * Number of bits whose value depends on a carry (for encoding purposes).
+    * <p>
+    * bitsOutstanding of the standard.
+    */
+   private int bitsOutstanding;
+ 
+   /**
+    * Bits written or read that are not in the stream yet or have not been consumed.
+    * <p>
+    * The valid bits are the <code>numBits</code> least significant ones.
+    */
+   private int bitBuffer;
+ 
+   /**
+    * Number of valid bits in <code>bitBuffer</code>.
+    * <p>
+    * In the range [0, 8] when encoding.
+    */
+   private int numBits;
+ 
+   /**
+    * Position of the next byte read (for decoding purposes).
+    * <p>
+    * Bytes from <code>end</code> onwards are read as 0.
+    */
+   private int position;
+ 
+   /**
+    * End of the segment read (for decoding purposes).
+    * <p>
+    * Exclusive.
+    */
+   private int end;
+ 
+ 
+   /**
+    * Creates the coder. Before coding, the stream must be set with <code>changeStream</code>
+    * and the coder restarted.
+    *
+    * @param numContexts number of contexts
+    */
+   public CABACCoder(int numContexts){
+     this.numContexts = numContexts;
+     contextState = new int[numContexts];
+     contextMPS = new int[numContexts];
+     reset();
+     restartEncoding();
+   }
+ 
+   /**
+    * Changes the current stream.
+    *
+    * @param stream the new ByteStream
+    */
+   public void changeStream(ByteStream stream){
+     this.stream = stream;
+   }
+ 
+   /**
+    * Resets the state of all contexts to the equiprobable state.
+    */
+   public void reset(){
+     for(int c = 0; c < numContexts; c++){
+       contextState[c] = 0;
+       contextMPS[c] = 0;
+     }
+   }
+ 
+   /**
+    * Restarts the registers of the coder for encoding. Bytes are appended to the stream.
+    */
+   public void restartEncoding(){
+     range = 510;
+     low = 0;
+     firstBit = true;
+     bitsOutstanding = 0;
+     bitBuffer = 0;
+     numBits = 0;
+   }
+ 
+   /**
+    * Restarts the registers of the coder for decoding the whole stream.
+    *
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void restartDecoding() throws Exception{
+     restartDecoding(0, (int) stream.getLength());
+   }
+ 
+   /**
+    * Restarts the registers of the coder for decoding a segment of the stream.
+    *
+    * @param begin first byte of the segment (inclusive)
+    * @param end last byte of the segment (exclusive)
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void restartDecoding(int begin, int end) throws Exception{
+     position = begin;
+     this.end = end;
+     bitBuffer = 0;
+     numBits = 0;
+     range = 510;
+     low = readBits(8);
+     low = (low << 1) | readBits(1);
+   }
+ 
+   /**
+    * Encodes a bit using a context.
+    *
+    * @param bit input
+    * @param context context of the symbol
+    */
+   public void encodeBitContext(boolean bit, int context){
+     int state = contextState[context];
+     int rangeLPS = RANGE_LPS[state][(range >> 6) & 3];
+     range -= rangeLPS;
+     if((bit ? 1: 0) != contextMPS[context]){
+       low += range;
+       range = rangeLPS;
+       if(state == 0){
+         contextMPS[context] ^= 1;
+       }
+       contextState[context] = TRANSITIONS_LPS[state];
+     }else{
+       contextState[context] = TRANSITIONS_MPS[state];
+       if(range >= 256){
+         return;
+       }
+     }
+     renormalizeEncoder();
+   }
+ 
+   /**
+    * Encodes a sequence of bits, each one with its own context.
+    *
+    * @param bits input bits, either 0 or 1
+    * @param contexts context of each bit
+    * @param length number of bits to encode
+    */
+   public void encodeBitsContext(int[] bits, int[] contexts, int length){
+     for(int i = 0; i < length; i++){
+       encodeBitContext(bits[i] != 0, contexts[i]);
+     }
+   }
+ 
+   /**
+    * Decodes a bit using a context.
+    *
+    * @param context context of the symbol
+    * @return output bit
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public boolean decodeBitContext(int context) throws Exception{
+     int state = contextState[context];
+     int bit = contextMPS[context];
+     int rangeLPS = RANGE_LPS[state][(range >> 6) & 3];
+     range -= rangeLPS;
+     if(low >= range){
+       bit ^= 1;
+       low -= range;
+       range = rangeLPS;
+       if(state == 0){
+         contextMPS[context] ^= 1;
+       }
+       contextState[context] = TRANSITIONS_LPS[state];
+     }else{
+       contextState[context] = TRANSITIONS_MPS[state];
+       if(range >= 256){
+         return(bit != 0);
+       }
+     }
+     renormalizeDecoder();
+     return(bit != 0);
+   }
+ 
+   /**
+    * Encodes a bit using a specified probability. The sub-range of the least probable symbol is
+    * computed with a multiplication instead of the table; the contexts are not modified.
+    *
+    * @param bit input
+    * @param prob0 probability of the symbol 0, as given by <code>ArithmeticCoder.prob0ToMQ</code>
+    */
+   public void encodeBitProb(boolean bit, int prob0){
+     int rangeLPS = probToRange(prob0);
+     range -= rangeLPS;
+     if((bit ? 1: 0) != (prob0 >= 0 ? 0: 1)){
+       low += range;
+       range = rangeLPS;
+     }
+     renormalizeEncoder();
+   }
+ 
+   /**
+    * Decodes a bit using a specified probability.
+    *
+    * @param prob0 probability of the symbol 0, as given by <code>ArithmeticCoder.prob0ToMQ</code>
+    * @return output bit
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public boolean decodeBitProb(int prob0) throws Exception{
+     int bit = prob0 >= 0 ? 0: 1;
+     int rangeLPS = probToRange(prob0);
+     range -= rangeLPS;
+     if(low >= range){
+       bit ^= 1;
+       low -= range;
+       range = rangeLPS;
+     }
+     renormalizeDecoder();
+     return(bit != 0);
+   }
+ 
+   /**
+    * Terminates the current stream (for encoding purposes), as the flushing procedure of the
+    * standard: the 10 bits of the lower end are written with the last one set to 1, and the last
+    * byte is padded with 0s.
+    */
+   public void terminate(){
+     range = 2;
+     renormalizeEncoder();
+     putBit((low >> 9) & 1);
+     writeBit((low >> 8) & 1);
+     writeBit(1);
+     if(numBits > 0){
+       stream.putByte((byte) (bitBuffer << (8 - numBits)));
+       bitBuffer = 0;
+       numBits = 0;
+     }
+   }
+ 
+   /**
+    * Renormalizes the interval after coding a symbol (for encoding purposes).
+    */
+   private void renormalizeEncoder(){
+     while(range < 256){
+       if(low < 256){
+         putBit(0);
+       }else if(low >= 512){
+         low -= 512;
+         putBit(1);
+       }else{
+         low -= 256;
+         bitsOutstanding++;
+       }
+       range <<= 1;
+       low <<= 1;
+     }
+   }
+ 
+   /**
+    * Renormalizes the interval after decoding a symbol, reading all the bits needed at once (for
+    * decoding purposes).
+    *
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   private void renormalizeDecoder() throws Exception{
+     int shift = Integer.numberOfLeadingZeros(range) - 23;
+     if(shift > 0){
+       range <<= shift;
+       low = (low << shift) | readBits(shift);
+     }
+   }
+ 
+   /**
+    * Writes a bit followed by the outstanding bits, which take the opposite value (for encoding
+    * purposes).
+    *
+    * @param bit 0 or 1
+    */
+   private void putBit(int bit){
+     if(firstBit){
+       firstBit = false;
+     }else{
+       writeBit(bit);
+     }
+     while(bitsOutstanding > 0){
+       writeBit(1 - bit);
+       bitsOutstanding--;
+     }
+   }
+ 
+   /**
+    * Writes a bit to the stream (for encoding purposes).
+    *
+    * @param bit 0 or 1
+    */
+   private void writeBit(int bit){
+     bitBuffer = (bitBuffer << 1) | bit;
+     numBits++;
+     if(numBits == 8){
+       stream.putByte((byte) bitBuffer);
+       bitBuffer = 0;
+       numBits = 0;
+     }
+   }
+ 
+   /**
+    * Reads some bits from the stream, 0s past the end of the segment (for decoding purposes).
+    *
+    * @param n number of bits, in the range [1, 8]
+    * @return the bits read
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   private int readBits(int n) throws Exception{
+     if(numBits < n){
+       int b = 0;
+       if(position < end){
+         b = stream.getByte(position++) & 0xFF;
+       }
+       bitBuffer = (bitBuffer << 8) | b;
+       numBits += 8;
+     }
+     numBits -= n;
+     return((bitBuffer >>> numBits) & ((1 << n) - 1));
+   }
+ 
+   /**
+    * Converts a probability given as in <code>ArithmeticCoder.encodeBitProb</code> into the
+    * sub-range of the least probable symbol.
+    *
+    * @param prob0 probability of the symbol 0
+    * @return sub-range of the least probable symbol, at least 2 and at most half the range
+    */
+   private int probToRange(int prob0){
+     int rangeLPS = (range * ArithmeticCoder.MQToProbFixed(prob0, 15)) >> 15;
+     return(rangeLPS < 2 ? 2: (rangeLPS > (range >> 1) ? range >> 1: rangeLPS));
+   }
+ }
\ No newline at end of file
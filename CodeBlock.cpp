@@ -0,0 +1,107 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ import streams.ByteStream;
+ 
+ 
+ /**
+  * This class holds a code-block and its coded stream, so that many code-blocks can be handed
+  * to the <code>Tier1Engine</code> at once. When encoding, the samples, dimensions and subband are
+  * read and the stream, number of bit planes, number of passes and pass ends are written. When
+  * decoding, the opposite.<br>
+  *
+  * Multithreading support: a code-block must be manipulated by a single thread at a time.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class CodeBlock{
+ 
+   /**
+    * Samples of the code-block, row by row, in two's complement.
+    * <p>
+    * Its length must be at least width * height.
+    */
+   public int[] samples;
+ 
+   /**
+    * Width of the code-block.
+    * <p>
+    * Greater than 0.
+    */
+   public int width;
+ 
+   /**
+    * Height of the code-block.
+    * <p>
+    * Greater than 0.
+    */
+   public int height;
+ 
+   /**
+    * Subband to which the code-block belongs.
+    * <p>
+    * One of the <code>SUBBAND_*</code> constants of <code>Tier1Coder</code>.
+    */
+   public int subband;
+ 
+   /**
+    * Coded stream of the code-block.
+    * <p>
+    * When encoding, a new stream is created if it is null.
+    */
+   public ByteStream stream = null;
+ 
+   /**
+    * Number of magnitude bit planes of the code-block.
+    * <p>
+    * Set by the encoder, needed by the decoder.
+    */
+   public int numBitPlanes = 0;
+ 
+   /**
+    * Number of coding passes of the code-block.
+    * <p>
+    * Set by the encoder, needed by the decoder (it may be smaller to decode a truncated stream).
+    */
+   public int numPasses = 0;
+ 
+   /**
+    * Coding options of the code-block.
+    * <p>
+    * Combination of the <code>OPTION_*</code> constants of <code>Tier1Coder</code>. Must be the
+    * same when encoding and decoding.
+    */
+   public int options = 0;
+ 
+   /**
+    * End of each coding pass in the stream (see <code>Tier1Coder.getPassEnds</code>).
+    * <p>
+    * Set by the encoder. Needed by the decoder only with <code>Tier1Coder.OPTION_TERMINATE_ALL</code>.
+    */
+   public int[] passEnds = null;
+ 
+ 
+   /**
+    * Creates a code-block.
+    *
+    * @param samples samples of the code-block, row by row, in two's complement
+    * @param width width of the code-block
+    * @param height height of the code-block
+    * @param subband subband to which the code-block belongs
+    */
+   public CodeBlock(int[] samples, int width, int height, int subband){
+     this.samples = samples;
+     this.width = width;
+     this.height = height;
+     this.subband = subband;
+   }
+ }
\ No newline at end of file
@@ -32,7 +32,7 @@
   * @author Francesc Auli-Llinas
   * @version 1.0
   */
- public final class ArithmeticCoder{
+ public final class ArithmeticCoder implements BinaryCoder{
  
    /**
     * ByteStream employed by the coder to write/read the output/input bytes.
@@ -76,6 +76,50 @@
     */
    private int L;
  
+   /**
+    * End of the segment of the stream being decoded (for decoding purposes).
+    * <p>
+    * Exclusive. Bytes from this position onwards are read as 0xFF.
+    */
+   private int segmentEnd = 0;
+ 
+   /**
+    * Bytes of the easy termination computed by <code>terminateOptimal</code>.
+    * <p>
+    * Only the first <code>numTerminationBytes</code> positions are valid. At most 5 bytes are needed.
+    */
+   private int[] terminationBytes = new int[5];
+ 
+   /**
+    * Number of valid bytes in <code>terminationBytes</code>.
+    * <p>
+    * Set when the stream is terminated.
+    */
+   private int numTerminationBytes = 0;
+ 
+   /**
+    * Code register of the inverted decoder (for decoding purposes).
+    * <p>
+    * Distance from the code value to the upper bound of the interval, i.e., (A << 8) - 1 minus the
+    * 24 least significant bits of C. It is only valid when <code>invertedDecoding</code> is true.
+    */
+   private int D;
+ 
+   /**
+    * Minimum value of A for which the inverted decoder decodes the most probable symbol without
+    * conditional exchange nor renormalization.
+    * <p>
+    * Equal to max((D >> 8) + 1, 0x8000). It is only valid when <code>invertedDecoding</code> is true.
+    */
+   private int Athr;
+ 
+   /**
+    * Indicates whether the decoder employs the inverted code register.
+    * <p>
+    * Set through <code>setInvertedDecoding</code>.
+    */
+   private boolean invertedDecoding = false;
+ 
    /**
     * Number of contexts.
     * <p>
@@ -98,11 +142,91 @@
    private int[] contextMPS = null;
  
    /**
-    * Transition to the next state when coding the most probable symbol.
+    * Marks the contexts modified since the last reset (only when sparse reset is enabled).
+    * <p>
+    * Null when sparse reset is disabled.
+    */
+   private boolean[] contextTouched = null;
+ 
+   /**
+    * Contexts modified since the last reset, in the order in which they were modified.
+    * <p>
+    * Its length is the maximum number of contexts restored individually by <code>reset</code>.
+    */
+   private int[] touchedContexts = null;
+ 
+   /**
+    * Number of contexts modified since the last reset.
+    * <p>
+    * When greater than <code>touchedContexts.length</code>, the list is incomplete and all
+    * contexts are reset.
+    */
+   private int numTouchedContexts = 0;
+ 
+   /**
+    * Table that maps context keys to contexts (only when the coder employs hashed contexts).
+    * <p>
+    * Null when contexts are indexed directly.
+    */
+   private HashedContextTable contextTable = null;
+ 
+   /**
+    * Initial state of each context, restored by <code>reset</code>.
+    * <p>
+    * Null when all contexts start at state 0; set through <code>loadInitialStates</code>.
+    */
+   private int[] initialState = null;
+ 
+   /**
+    * Initial most probable symbol of each context, restored by <code>reset</code>.
+    * <p>
+    * Null when all contexts start with MPS 0; set through <code>loadInitialStates</code>.
+    */
+   private int[] initialMPS = null;
+ 
+   /**
+    * Contexts modified by <code>estimateCost</code>, in coding order.
+    * <p>
+    * Grown when needed.
+    */
+   private int[] estimateContexts = null;
+ 
+   /**
+    * Previous state of the contexts modified by <code>estimateCost</code>, as (state << 1) | MPS.
+    * <p>
+    * Parallel to <code>estimateContexts</code>.
+    */
+   private int[] estimateStates = null;
+ 
+   /**
+    * Interval register that drives the state transitions of <code>updateContext</code>, as A
+    * drives those of <code>encodeBitContext</code>.
+    * <p>
+    * Restored by <code>reset</code>.
+    */
+   private int updateA = 0x8000;
+ 
+   /**
+    * Accumulates the values loaded by the prefetch functions.
+    * <p>
+    * Its value is meaningless; it only prevents the loads from being discarded by the compiler.
+    */
+   private int prefetchSink = 0;
+ 
+   /**
+    * Fraction of the contexts up to which the sparse reset is employed.
+    * <p>
+    * When more than numContexts / SPARSE_RESET_FRACTION contexts are modified, all of them are reset.
+    */
+   private static final int SPARSE_RESET_FRACTION = 8;
+ 
+   /**
+    * Transition to the next state when coding the most probable symbol. The state tables are
+    * package-visible so that the <code>RANSCoder</code> employs the same state machine.
     * <p>
     * Each index must in the range [0, STATE_TRANSITIONS_MPS.length - 1]
     */
-   private static final int[] STATE_TRANSITIONS_MPS = {1, 2, 3, 4, 5, 38, 7, 8, 9, 10,
+   static final int[] STATE_TRANSITIONS_MPS = {1, 2, 3, 4, 5, 38, 7, 8, 9, 10,
      11, 12, 13, 29, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30,
      31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 45, 46};
  
@@ -111,7 +235,7 @@
     * <p>
     * Each index must in the range [0, STATE_TRANSITIONS_MPS.length - 1]
     */
-   private static final int[] STATE_TRANSITIONS_LPS = {1, 6, 9, 12, 29, 33, 6, 14, 14,
+   static final int[] STATE_TRANSITIONS_LPS = {1, 6, 9, 12, 29, 33, 6, 14, 14,
      14, 17, 18, 20, 21, 14, 14, 15, 16, 17, 18, 19, 19, 20, 21, 22, 23, 24, 25, 26,
      27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 46};
  
@@ -120,7 +244,7 @@
     * <p>
     * 1 indicates a change of the MPS.
     */
-   private static final int[] STATE_CHANGE = {1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0,
+   static final int[] STATE_CHANGE = {1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0,
      0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
      0, 0, 0, 0, 0, 0, 0, 0};
  
@@ -129,7 +253,7 @@
     * <p>
     * The real probability can be computed as the coded probability expressed in this array 0xXXXX / (2^16 * \alpha), with \alpha = 0.708.
     */
-   private static final int[] STATE_PROB = {0x5601, 0x3401, 0x1801, 0x0AC1, 0x0521,
+   static final int[] STATE_PROB = {0x5601, 0x3401, 0x1801, 0x0AC1, 0x0521,
      0x0221, 0x5601, 0x5401, 0x4801, 0x3801, 0x3001, 0x2401, 0x1C01, 0x1601, 0x5601,
      0x5401, 0x5101, 0x4801, 0x3801, 0x3401, 0x3001, 0x2801, 0x2401, 0x2201, 0x1C01,
      0x1801, 0x1601, 0x1401, 0x1201, 0x1101, 0x0AC1, 0x09C1, 0x08A1, 0x0521, 0x0441,
@@ -146,6 +270,45 @@
      1 << 16, 1 << 17, 1 << 18, 1 << 19, 1 << 20, 1 << 21, 1 << 22, 1 << 23, 1 << 24,
      1 << 25, 1 << 26, 1 << 27, 1 << 28, 1 << 29, 1 << 30};
  
+   /**
+    * Factor that converts a probability to the integer of the MQ coder.
+    * <p>
+    * (4/3) * 0x8000, rounded.
+    */
+   private static final int PROB_TO_MQ = 43691;
+ 
+   /**
+    * Number of fractional bits of the estimated costs.
+    * <p>
+    * Costs are in 1/2^COST_BITS bits.
+    */
+   static final int COST_BITS = 8;
+ 
+   /**
+    * Estimated cost of coding the most probable symbol in each state, -log2(1 - p), where p is
+    * the probability of the least probable symbol of the state.
+    * <p>
+    * In 1/2^COST_BITS bits.
+    */
+   static final int[] STATE_COST_MPS = new int[STATE_PROB.length];
+ 
+   /**
+    * Estimated cost of coding the least probable symbol in each state, -log2(p).
+    * <p>
+    * In 1/2^COST_BITS bits.
+    */
+   static final int[] STATE_COST_LPS = new int[STATE_PROB.length];
+ 
+   static{
+     //The real probability is STATE_PROB / (2^16 * 0.708)
+     for(int state = 0; state < STATE_PROB.length; state++){
+       double p = STATE_PROB[state] / (65536d * 0.708d);
+       double scale = (1 << COST_BITS) / Math.log(2d);
+       STATE_COST_MPS[state] = (int) Math.round(-Math.log(1d - p) * scale);
+       STATE_COST_LPS[state] = (int) Math.round(-Math.log(p) * scale);
+     }
+   }
+ 
  
    /**
     * Initializes internal registers. Before using the coder, a stream has to be set
@@ -170,6 +333,23 @@
      restartEncoding();
    }
  
+   /**
+    * Initializes internal registers and creates one context for each slot of the table. The
+    * contexts are then accessed through 64-bit keys with the functions <code>encodeBitHashedContext</code>
+    * and <code>decodeBitHashedContext</code>. Before using the coder, a stream has to be set
+    * through <code>changeStream</code>.
+    *
+    * @param contextTable table that maps context keys to contexts
+    */
+   public ArithmeticCoder(HashedContextTable contextTable){
+     this.contextTable = contextTable;
+     this.numContexts = contextTable.getNumSlots();
+     contextState = new int[numContexts];
+     contextMPS = new int[numContexts];
+     reset();
+     restartEncoding();
+   }
+ 
    /**
     * Encodes a bit using a context so that the probabilities are adaptively adjusted
     * depending on the incoming symbols.
@@ -192,6 +372,9 @@
          }else{
            C += p;
          }
+         if(contextTouched != null){
+           touchContext(context);
+         }
          contextState[context] = STATE_TRANSITIONS_MPS[contextState[context]];
          while(A < (1 << 15)){
            A <<= 1;
@@ -208,6 +391,9 @@
        }else{
          A = p;
        }
+       if(contextTouched != null){
+         touchContext(context);
+       }
        if(STATE_CHANGE[contextState[context]] == 1){
          contextMPS[context] = contextMPS[context] == 0 ? 1: 0; //Switches MPS/LPS if necessary
        }
@@ -223,6 +409,121 @@
      }
    }
  
+   /**
+    * Estimates the cost of encoding a sequence of bits with their contexts, with the costs of
+    * <code>STATE_COST_MPS</code> and <code>STATE_COST_LPS</code>. The state transitions are
+    * simulated with a copy of the interval register, so the estimate follows the adaptation of the
+    * contexts along the sequence; the coder is left unchanged.
+    *
+    * @param bits input bits, either 0 or 1
+    * @param contexts context of each bit
+    * @param length number of bits
+    * @return estimated cost in 1/2^COST_BITS bits
+    */
+   public long estimateCost(int[] bits, int[] contexts, int length){
+     if((estimateContexts == null) || (estimateContexts.length < length)){
+       estimateContexts = new int[length];
+       estimateStates = new int[length];
+     }
+     long cost = 0;
+     int A = this.A;
+     for(int i = 0; i < length; i++){
+       int context = contexts[i];
+       int state = contextState[context];
+       int s = contextMPS[context];
+       estimateContexts[i] = context;
+       estimateStates[i] = (state << 1) | s;
+       int p = STATE_PROB[state];
+       A -= p;
+       if(bits[i] == s){
+         cost += STATE_COST_MPS[state];
+         if(A < (1 << 15)){
+           A = A < p ? p: A;
+           contextState[context] = STATE_TRANSITIONS_MPS[state];
+         }
+       }else{
+         cost += STATE_COST_LPS[state];
+         A = A < p ? A: p;
+         contextMPS[context] = s ^ STATE_CHANGE[state];
+         contextState[context] = STATE_TRANSITIONS_LPS[state];
+       }
+       while(A < (1 << 15)){
+         A <<= 1;
+       }
+     }
+     //Restores the contexts in reverse order, so each one ends with its first saved state
+     for(int i = length - 1; i >= 0; i--){
+       int context = estimateContexts[i];
+       contextState[context] = estimateStates[i] >> 1;
+       contextMPS[context] = estimateStates[i] & 1;
+     }
+     return(cost);
+   }
+ 
+   /**
+    * Encodes a sequence of bits, each one with its own context, as successive calls to
+    * <code>encodeBitContext</code> would do. The registers are kept in local variables during the
+    * whole sequence, which is faster when the symbols and their contexts are known in advance.
+    *
+    * @param bits input bits, either 0 or 1
+    * @param contexts context of each bit
+    * @param length number of bits to encode
+    */
+   public void encodeBitsContext(int[] bits, int[] contexts, int length){
+     int A = this.A;
+     int C = this.C;
+     int t = this.t;
+     for(int i = 0; i < length; i++){
+       int context = contexts[i];
+       int s = contextMPS[context];
+       int p = STATE_PROB[contextState[context]];
+ 
+       A -= p;
+       if(bits[i] == s){ //Codes the most probable symbol
+         if(A >= (1 << 15)){
+           C += p;
+           continue;
+         }
+         if(A < p){
+           A = p;
+         }else{
+           C += p;
+         }
+         if(contextTouched != null){
+           touchContext(context);
+         }
+         contextState[context] = STATE_TRANSITIONS_MPS[contextState[context]];
+       }else{ //Codes the least probable symbol
+         if(A < p){
+           C += p;
+         }else{
+           A = p;
+         }
+         if(contextTouched != null){
+           touchContext(context);
+         }
+         if(STATE_CHANGE[contextState[context]] == 1){
+           contextMPS[context] = contextMPS[context] == 0 ? 1: 0; //Switches MPS/LPS if necessary
+         }
+         contextState[context] = STATE_TRANSITIONS_LPS[contextState[context]];
+       }
+       while(A < (1 << 15)){
+         A <<= 1;
+         C <<= 1;
+         t--;
+         if(t == 0){
+           this.C = C;
+           transferByte();
+           C = this.C;
+           t = this.t;
+         }
+       }
+     }
+     this.A = A;
+     this.C = C;
+     this.t = t;
+   }
+ 
    /**
     * Decodes a bit using a context so that the probabilities are adaptively adjusted
     * depending on the outcoming symbols.
@@ -232,6 +533,9 @@
     * @throws Exception when some problem manipulating the stream occurs
     */
    public boolean decodeBitContext(int context) throws Exception{
+     if(invertedDecoding){
+       return(decodeBitContextInverted(context));
+     }
      int p = STATE_PROB[contextState[context]];
      int s = contextMPS[context];
      int x = s;
@@ -240,6 +544,9 @@
      if((C & 0x00FFFF00) >= (p << 8)){
        C = ((C & ~0xFFFFFF00) | ((C & 0x00FFFF00) - (p << 8)));
        if(A < (1 << 15)){
+         if(contextTouched != null){
+           touchContext(context);
+         }
          if(A < p){
            x = 1 - s;
            if(STATE_CHANGE[contextState[context]] == 1){
@@ -259,6 +566,9 @@
          }
        }
      }else{
+       if(contextTouched != null){
+         touchContext(context);
+       }
        if(A < p){
          contextState[context] = STATE_TRANSITIONS_MPS[contextState[context]];
        }else{
@@ -281,6 +591,87 @@
      return(x == 1);
    }
  
+   /**
+    * Encodes a bit using the context assigned to a key by the hashed context table. The coder
+    * must have been created with a <code>HashedContextTable</code>.
+    *
+    * @param bit input
+    * @param key context key of the symbol
+    */
+   public void encodeBitHashedContext(boolean bit, long key){
+     encodeBitContext(bit, findContext(key));
+   }
+ 
+   /**
+    * Decodes a bit using the context assigned to a key by the hashed context table. The coder
+    * must have been created with a <code>HashedContextTable</code>.
+    *
+    * @param key context key of the symbol
+    * @return output bit
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public boolean decodeBitHashedContext(long key) throws Exception{
+     return(decodeBitContext(findContext(key)));
+   }
+ 
+   /**
+    * Gets the context assigned to a key by the hashed context table, initializing it when the
+    * key has been newly inserted in the table.
+    *
+    * @param key context key
+    * @return context of the key
+    */
+   private int findContext(long key){
+     int context = contextTable.find(key);
+     if(context < 0){
+       context = ~context;
+       contextState[context] = 0;
+       contextMPS[context] = 0;
+     }
+     return(context);
+   }
+ 
+   /**
+    * Brings the state of a context into the cache before it is employed. It is useful when the
+    * contexts of the next symbols are known in advance and the number of contexts is large, so
+    * that the memory latency overlaps with the coding of the current symbols. Since the language
+    * does not expose prefetch instructions, the state is warmed through a regular load.
+    *
+    * @param context context of an upcoming symbol
+    */
+   public void prefetchContext(int context){
+     prefetchSink += contextState[context] + contextMPS[context];
+   }
+ 
+   /**
+    * Brings the state of several contexts into the cache before they are employed (see
+    * <code>prefetchContext</code>).
+    *
+    * @param contexts contexts of the upcoming symbols
+    * @param offset first position of contexts to prefetch
+    * @param length number of contexts to prefetch
+    */
+   public void prefetchContexts(int[] contexts, int offset, int length){
+     int sink = 0;
+     for(int i = offset; i < offset + length; i++){
+       int context = contexts[i];
+       sink += contextState[context] + contextMPS[context];
+     }
+     prefetchSink += sink;
+   }
+ 
+   /**
+    * Brings the bucket of a key of the hashed context table and the state of its context into
+    * the cache before they are employed. The coder must have been created with a
+    * <code>HashedContextTable</code>.
+    *
+    * @param key context key of an upcoming symbol
+    */
+   public void prefetchHashedContext(long key){
+     int context = contextTable.prefetch(key);
+     prefetchSink += contextState[context] + contextMPS[context];
+   }
+ 
    /**
     * Encodes a bit using a specified probability.
     *
@@ -353,6 +744,9 @@
     * @throws Exception when some problem manipulating the stream occurs
     */
    public boolean decodeBitProb(int prob0) throws Exception{
+     if(invertedDecoding){
+       return(decodeBitProbInverted(prob0));
+     }
      int p;
      int s = 0;
      if(prob0 >= 0){
@@ -396,6 +790,137 @@
      return(x == 1);
    }
  
+   /**
+    * Decodes a bit using a context with the inverted code register. The code value is kept as
+    * its distance D to the upper bound of the interval. Since decoding the most probable symbol in
+    * the upper subinterval leaves D untouched, the common case only needs to subtract the
+    * probability from A and compare it with <code>Athr</code>. The decoded symbols are the same
+    * as those of <code>decodeBitContext</code>.
+    *
+    * @param context context of the symbols
+    * @return output bit
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   private boolean decodeBitContextInverted(int context) throws Exception{
+     int p = STATE_PROB[contextState[context]];
+     A -= p;
+     if(A >= Athr){ //Most probable symbol without exchange nor renormalization
+       return(contextMPS[context] == 1);
+     }
+ 
+     int s = contextMPS[context];
+     int x = s;
+     if(contextTouched != null){
+       touchContext(context);
+     }
+     if((D >> 8) < A){ //Upper subinterval
+       if(A < p){
+         x = 1 - s;
+         if(STATE_CHANGE[contextState[context]] == 1){
+           contextMPS[context] = contextMPS[context] == 0 ? 1: 0; //Switches MPS/LPS if necessary
+         }
+         contextState[context] = STATE_TRANSITIONS_LPS[contextState[context]];
+       }else{
+         contextState[context] = STATE_TRANSITIONS_MPS[contextState[context]];
+       }
+     }else{ //Lower subinterval
+       D -= A << 8;
+       if(A < p){
+         contextState[context] = STATE_TRANSITIONS_MPS[contextState[context]];
+       }else{
+         x = 1 - s;
+         if(STATE_CHANGE[contextState[context]] == 1){
+           contextMPS[context] = contextMPS[context] == 0 ? 1: 0; //Switches MPS/LPS if necessary
+         }
+         contextState[context] = STATE_TRANSITIONS_LPS[contextState[context]];
+       }
+       A = p;
+     }
+     while(A < (1 << 15)){
+       if(t == 0){
+         fillLSBInverted();
+       }
+       A <<= 1;
+       D = (D << 1) | 1;
+       t--;
+     }
+     Athr = (D >> 8) + 1;
+     if(Athr < (1 << 15)){
+       Athr = 1 << 15;
+     }
+     return(x == 1);
+   }
+ 
+   /**
+    * Decodes a bit using a specified probability with the inverted code register (see
+    * <code>decodeBitContextInverted</code>).
+    *
+    * @param prob0 probability of the symbol as in <code>decodeBitProb</code>
+    * @return output bit
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   private boolean decodeBitProbInverted(int prob0) throws Exception{
+     int p;
+     int s = 0;
+     if(prob0 >= 0){
+       p = prob0;
+     }else{
+       p = -prob0;
+       s = 1;
+     }
+     A -= p;
+     if(A >= Athr){ //Most probable symbol without exchange nor renormalization
+       return(s == 1);
+     }
+ 
+     int x = s;
+     if((D >> 8) < A){ //Upper subinterval
+       if(A < p){
+         x = 1 - s;
+       }
+     }else{ //Lower subinterval
+       D -= A << 8;
+       if(A >= p){
+         x = 1 - s;
+       }
+       A = p;
+     }
+     while(A < (1 << 15)){
+       if(t == 0){
+         fillLSBInverted();
+       }
+       A <<= 1;
+       D = (D << 1) | 1;
+       t--;
+     }
+     Athr = (D >> 8) + 1;
+     if(Athr < (1 << 15)){
+       Athr = 1 << 15;
+     }
+     return(x == 1);
+   }
+ 
+   /**
+    * Selects the decoder core. The inverted decoder decodes the same symbols as the regular one
+    * with fewer operations per symbol. The registers are converted, so the core can be changed at
+    * any point of the decoding.
+    *
+    * @param invertedDecoding true to employ the inverted code register, false to employ the
+    * regular one
+    */
+   public void setInvertedDecoding(boolean invertedDecoding){
+     if(invertedDecoding && !this.invertedDecoding){
+       D = (A << 8) - 1 - (C & 0x00FFFFFF);
+       Athr = (D >> 8) + 1;
+       if(Athr < (1 << 15)){
+         Athr = 1 << 15;
+       }
+     }else if(!invertedDecoding && this.invertedDecoding){
+       C = (A << 8) - 1 - D;
+     }
+     this.invertedDecoding = invertedDecoding;
+   }
+ 
    /**
     * Transforms the probability of the symbol 0 (or false) in the range [0:1] into
     * the integer required in the MQ coder to represent that probability.
@@ -432,6 +957,94 @@
      return(prob0);
    }
  
+   /**
+    * Transforms the probability of the symbol 0 (or false) in fixed point into the integer
+    * required in the MQ coder, with a multiplication and a shift instead of float arithmetic. The
+    * probability of the least probable symbol is clamped so that the integer is never 0.
+    *
+    * @param prob0 in the range [0, 2^bits]
+    * @param bits number of fractional bits of prob0, in the range [1, 16]
+    * @return integer that can be feed to the MQ coder
+    */
+   public static int probToMQ(int prob0, int bits){
+     //Without branches: s is -1 when the symbol 0 is the least probable, 0 otherwise
+     int q = prob0 - (1 << (bits - 1));
+     int s = q >> 31;
+     int probLPS = (1 << (bits - 1)) - ((q ^ s) - s);
+     int probMQ = (probLPS * PROB_TO_MQ) >> bits;
+     probMQ += (probMQ - 1) >>> 31;
+     return((probMQ ^ s) - s);
+   }
+ 
+   /**
+    * Transforms the integer of the MQ coder into the probability of the least probable symbol in
+    * fixed point (the inverse of <code>probToMQ</code> for that symbol). The probability in 15
+    * bits is 3/4 of the integer, since an interval of the MQ coder is 4/3 * 0x8000 on average.
+    *
+    * @param probMQ integer as given by <code>prob0ToMQ</code>; its sign, which tells the least
+    * probable symbol, is ignored
+    * @param bits number of fractional bits of the result, in the range [1, 17]
+    * @return probability of the least probable symbol, not clamped
+    */
+   public static int MQToProbFixed(int probMQ, int bits){
+     int s = probMQ >> 31;
+     return((((probMQ ^ s) - s) * 3) >> (17 - bits));
+   }
+ 
+   /**
+    * Transforms the probability of the symbol 0 (or false) in 12 bits into the integer required
+    * in the MQ coder.
+    *
+    * @param prob0 in the range [0, 2^12]
+    * @return integer that can be feed to the MQ coder
+    */
+   public static int prob12ToMQ(int prob0){
+     return(probToMQ(prob0, 12));
+   }
+ 
+   /**
+    * Transforms the probability of the symbol 0 (or false) in 15 bits into the integer required
+    * in the MQ coder.
+    *
+    * @param prob0 in the range [0, 2^15]
+    * @return integer that can be feed to the MQ coder
+    */
+   public static int prob15ToMQ(int prob0){
+     return(probToMQ(prob0, 15));
+   }
+ 
+   /**
+    * Transforms the probability of the symbol 0 (or false) in 16 bits into the integer required
+    * in the MQ coder.
+    *
+    * @param prob0 in the range [0, 2^16]
+    * @return integer that can be feed to the MQ coder
+    */
+   public static int prob16ToMQ(int prob0){
+     return(probToMQ(prob0, 16));
+   }
+ 
+   /**
+    * Transforms an array of probabilities of the symbol 0 (or false) in fixed point into the
+    * integers required in the MQ coder, as <code>probToMQ</code>. The loop has no branches so that
+    * it can be vectorized.
+    *
+    * @param probs0 probabilities, in the range [0, 2^bits]
+    * @param bits number of fractional bits of the probabilities, in the range [1, 16]
+    * @param probsMQ integers that can be feed to the MQ coder (output); it can be probs0
+    * @param length number of probabilities transformed
+    */
+   public static void probsToMQ(int[] probs0, int bits, int[] probsMQ, int length){
+     int half = 1 << (bits - 1);
+     for(int i = 0; i < length; i++){
+       int q = probs0[i] - half;
+       int s = q >> 31;
+       int probMQ = ((half - ((q ^ s) - s)) * PROB_TO_MQ) >> bits;
+       probMQ += (probMQ - 1) >>> 31;
+       probsMQ[i] = (probMQ ^ s) - s;
+     }
+   }
+ 
    /**
     * Transfers a byte to the stream (for encoding purposes).
     */
@@ -474,13 +1087,13 @@
    private void fillLSB() throws Exception{
      byte BL = 0;
      t = 8;
-     if(L < stream.getLength()){
+     if(L < segmentEnd){
        BL = stream.getByte(L);
      }
      //Reached the end of the stream
-     if((L == stream.getLength()) || ((Tr == 0xFF) && (BL > 0x8F))){
+     if((L == segmentEnd) || ((Tr == 0xFF) && (BL > 0x8F))){
        C += 0xFF;
-       if(L != stream.getLength()){
+       if(L != segmentEnd){
          throw new Exception("Read marker 0xFF in the stream.");
        }
      }else{
@@ -493,6 +1106,35 @@
      }
    }
  
+   /**
+    * Fills the inverted code register with a byte from the stream or with 0xFF when the end of
+    * the stream is reached (for decoding purposes). The byte is subtracted from D as it is added
+    * to C in <code>fillLSB</code>.
+    *
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   private void fillLSBInverted() throws Exception{
+     byte BL = 0;
+     t = 8;
+     if(L < segmentEnd){
+       BL = stream.getByte(L);
+     }
+     //Reached the end of the stream
+     if((L == segmentEnd) || ((Tr == 0xFF) && (BL > 0x8F))){
+       D -= 0xFF;
+       if(L != segmentEnd){
+         throw new Exception("Read marker 0xFF in the stream.");
+       }
+     }else{
+       if(Tr == 0xFF){
+         t = 7;
+       }
+       Tr = (0x000000FF & (int) BL);
+       L++;
+       D -= (Tr << (8 - t));
+     }
+   }
+ 
    /**
     * Changes the current stream. When encoding, before calling this function the stream
     * should be terminated calling the <code>terminate</code> function, and after calling
@@ -510,12 +1152,186 @@
    }
  
    /**
-    * Resets the state of all contexts.
+    * Resets the state of all contexts. When sparse reset is enabled and few contexts have been
+    * modified since the last reset, only these contexts are restored.
     */
    public void reset(){
+     if((contextTouched != null) && (numTouchedContexts <= touchedContexts.length)){
+       for(int i = 0; i < numTouchedContexts; i++){
+         int c = touchedContexts[i];
+         contextState[c] = initialState != null ? initialState[c]: 0;
+         contextMPS[c] = initialMPS != null ? initialMPS[c]: 0;
+         contextTouched[c] = false;
+       }
+     }else if(initialState != null){
+       System.arraycopy(initialState, 0, contextState, 0, numContexts);
+       System.arraycopy(initialMPS, 0, contextMPS, 0, numContexts);
+       if(contextTouched != null){
+         for(int c = 0; c < numContexts; c++){
+           contextTouched[c] = false;
+         }
+       }
+     }else{
+       for(int c = 0; c < numContexts; c++){
+         contextState[c] = 0;
+         contextMPS[c] = 0;
+       }
+       if(contextTouched != null){
+         for(int c = 0; c < numContexts; c++){
+           contextTouched[c] = false;
+         }
+       }
+     }
+     numTouchedContexts = 0;
+     updateA = 0x8000;
+     if(contextTable != null){
+       contextTable.clear();
+     }
+   }
+ 
+   /**
+    * Gets the probability of the current state of a context.
+    *
+    * @param context context of the symbol
+    * @return probability of the symbol 0, as given by <code>prob0ToMQ</code>
+    */
+   public int getContextProbability(int context){
+     int p = STATE_PROB[contextState[context]];
+     return(contextMPS[context] == 0 ? p: -p);
+   }
+ 
+   /**
+    * Updates the state of a context as if a bit had been coded with it, without coding it. It is
+    * employed when the bit is coded with <code>encodeBitProb</code> and another probability
+    * derived from the context. The transitions after the most probable symbol happen when the
+    * register <code>updateA</code> is renormalized, so encoder and decoder must update the
+    * contexts in the same order.
+    *
+    * @param bit bit coded
+    * @param context context of the bit
+    */
+   public void updateContext(boolean bit, int context){
+     int x = bit ? 1: 0;
+     int p = STATE_PROB[contextState[context]];
+     if(contextTouched != null){
+       touchContext(context);
+     }
+     updateA -= p;
+     if(x == contextMPS[context]){
+       if(updateA < (1 << 15)){
+         updateA = updateA < p ? p: updateA;
+         contextState[context] = STATE_TRANSITIONS_MPS[contextState[context]];
+       }
+     }else{
+       updateA = updateA < p ? updateA: p;
+       if(STATE_CHANGE[contextState[context]] == 1){
+         contextMPS[context] = contextMPS[context] == 0 ? 1: 0; //Switches MPS/LPS if necessary
+       }
+       contextState[context] = STATE_TRANSITIONS_LPS[contextState[context]];
+     }
+     while(updateA < (1 << 15)){
+       updateA <<= 1;
+     }
+   }
+ 
+   /**
+    * Sets the state of a context. It is employed to start some contexts in a state other than
+    * the initial one after calling <code>reset</code>.
+    *
+    * @param context context to set
+    * @param state state of the context, in the range [0, STATE_TRANSITIONS_MPS.length - 1]
+    * @param mps most probable symbol of the context, either 0 or 1
+    */
+   public void setContextState(int context, int state, int mps){
+     if(contextTouched != null){
+       touchContext(context);
+     }
+     contextState[context] = state;
+     contextMPS[context] = mps;
+   }
+ 
+   /**
+    * Loads the initial states of the contexts from a blob written by
+    * <code>ContextStateTrainer</code>, so that <code>reset</code> restores them instead of state
+    * 0. The contexts are reset. It cannot be employed with hashed contexts.
+    *
+    * @param blob stream that contains the blob
+    * @param position position of the blob in the stream
+    * @return position of the first byte after the blob
+    * @throws Exception when the blob is not valid for this coder or some problem manipulating the
+    * stream occurs
+    */
+   public int loadInitialStates(ByteStream blob, int position) throws Exception{
+     if(contextTable != null){
+       throw new Exception("Initial states cannot be employed with hashed contexts.");
+     }
+     int version = blob.getByte(position++) & 0xFF;
+     if(version != ContextStateTrainer.BLOB_VERSION){
+       throw new Exception("Unsupported version of the initial states.");
+     }
+     int blobContexts = 0;
+     for(int i = 0; i < 4; i++){
+       blobContexts = (blobContexts << 8) | (blob.getByte(position++) & 0xFF);
+     }
+     if(blobContexts != numContexts){
+       throw new Exception("Wrong number of contexts of the initial states.");
+     }
+     int[] states = new int[numContexts];
+     int[] mpss = new int[numContexts];
      for(int c = 0; c < numContexts; c++){
-       contextState[c] = 0;
-       contextMPS[c] = 0;
+       int packed = blob.getByte(position++) & 0xFF;
+       if((packed >> 1) >= STATE_PROB.length){
+         throw new Exception("Wrong state in the initial states.");
+       }
+       states[c] = packed >> 1;
+       mpss[c] = packed & 1;
+     }
+     initialState = states;
+     initialMPS = mpss;
+     //Contexts not modified since the last reset also have to take their new initial state
+     if(contextTouched != null){
+       numTouchedContexts = touchedContexts.length + 1;
+     }
+     reset();
+     return(position);
+   }
+ 
+   /**
+    * Enables or disables the sparse reset. When enabled, the coder keeps track of the contexts
+    * modified since the last reset so that <code>reset</code> restores only them. If more than
+    * a fraction of the contexts is modified, <code>reset</code> restores all contexts as usual.
+    * This is useful when the number of contexts is large and each message employs few of them.
+    *
+    * @param sparseReset true to enable the sparse reset
+    */
+   public void setSparseReset(boolean sparseReset){
+     if(sparseReset && (numContexts > 0)){
+       if(contextTouched == null){
+         contextTouched = new boolean[numContexts];
+         int maxTouchedContexts = numContexts / SPARSE_RESET_FRACTION;
+         touchedContexts = new int[maxTouchedContexts > 0 ? maxTouchedContexts: 1];
+         //Contexts modified before enabling are unknown, so the next reset restores all of them
+         numTouchedContexts = touchedContexts.length + 1;
+       }
+     }else{
+       contextTouched = null;
+       touchedContexts = null;
+       numTouchedContexts = 0;
+     }
+   }
+ 
+   /**
+    * Records that a context is going to be modified (for the sparse reset).
+    *
+    * @param context context of the symbol
+    */
+   private void touchContext(int context){
+     if(!contextTouched[context]){
+       contextTouched[context] = true;
+       if(numTouchedContexts < touchedContexts.length){
+         touchedContexts[numTouchedContexts] = context;
+       }
+       numTouchedContexts++;
      }
    }
  
@@ -536,8 +1352,22 @@
     * @throws Exception when some problem manipulating the stream occurs
     */
    public void restartDecoding() throws Exception{
+     restartDecoding(0, (int) stream.getLength());
+   }
+ 
+   /**
+    * Restarts the internal registers of the coder for decoding a segment of the stream. The
+    * segment is decoded as if it were a whole stream, so it must have been terminated
+    * independently by the encoder (calling <code>terminate</code> and <code>restartEncoding</code>).
+    *
+    * @param begin first byte of the segment (inclusive)
+    * @param end last byte of the segment (exclusive)
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void restartDecoding(int begin, int end) throws Exception{
+     segmentEnd = end;
      Tr = 0;
-     L  = 0;
+     L  = begin;
      C  = 0;
      fillLSB();
      C <<= t;
@@ -545,6 +1375,10 @@
      C <<= 7;
      t -= 7;
      A = 0x8000;
+     if(invertedDecoding){
+       invertedDecoding = false;
+       setInvertedDecoding(true);
+     }
    }
  
    /**
@@ -599,67 +1433,91 @@
  
    /**
     * Terminates the current stream using the optimal termination (for encoding purposes).
+    * The bytes of the easy termination are computed on the registers and only the bytes needed
+    * to recover the message are written to the stream, which produces the same output as
+    * writing the easy termination and truncating it afterwards.
     *
     * @throws Exception when some problem manipulating the stream occurs
     */
    public void terminateOptimal() throws Exception{
-     int NZTr = Tr;
-     int NZt = t;
-     int NZC = C;
-     int NZA = A;
-     int NZL = L;
- 
-     int lengthEmptyTermination = (int) stream.getLength();
-     terminateEasy();
-     int necessaryBytes = minFlush(NZTr, NZt, NZC, NZA, NZL, lengthEmptyTermination);
-     int lengthOptimalTermination = lengthEmptyTermination + necessaryBytes;
- 
-     if((lengthOptimalTermination >= 1) && ((stream.getByte(lengthOptimalTermination - 1) == 0xFF))){
-       lengthOptimalTermination--;
-     }
-     boolean elimination;
-     do{
-       elimination = false;
-       if((lengthOptimalTermination >= 2) &&
-       ((stream.getByte(lengthOptimalTermination - 2) == 0xFF) &&
-       (stream.getByte(lengthOptimalTermination - 1) == 0x7F))){
-         lengthOptimalTermination -= 2;
-         elimination = true;
-       }
-     }while(elimination);
-     stream.removeBytes((int) stream.getLength() - lengthOptimalTermination);
-   }
- 
-   /**
-    * Determines the minimum number of bytes needed to terminate the stream while assuring a
-    * complete recovering.
-    *
-    * @param NZTr Tr register for the normalization
-    * @param NZt t register for the normalization
-    * @param NZC C register for the normalization
-    * @param NZA A register for the normalization
-    * @param NZL number of flushed bytes
-    * @param lengthEmptyTermination length bytes used by the easy termination
-    * @return the number of bytes that should be flushed to terminate the ByteStream optimally
+     long Cr = ((long) Tr << 27) + ((long) C << t);
+     long Ar = (long) A << t;
+     //Nothing written since restartEncoding: the first byte of the segment is discarded
+     if((((Cr >> 32) & 0xFF) == 0x00) && (L == -1)){
+       Cr <<= 8;
+       Ar <<= 8;
+     }
+ 
+     //Easy termination without writing to the stream
+     numTerminationBytes = 0;
+     int nBits = 27 - 15 - t;
+     C <<= t;
+     while(nBits > 0){
+       transferTerminationByte();
+       nBits -= t;
+       C <<= t;
+     }
+     transferTerminationByte();
+     if(t == 7){
+       numTerminationBytes--;
+     }
+ 
+     int necessaryBytes = minFlush(Cr, Ar);
+     for(int b = 0; b < necessaryBytes; b++){
+       stream.putByte((byte) terminationBytes[b]);
+     }
+   }
+ 
+   /**
+    * Transfers a byte to <code>terminationBytes</code> instead of to the stream. The registers
+    * are updated as in <code>transferByte</code>.
+    */
+   private void transferTerminationByte(){
+     if(Tr == 0xFF){ //Bit stuff
+       terminationBytes[numTerminationBytes++] = Tr;
+       L++;
+       Tr = (C >>> 20); //Puts C_msbs to Tr
+       C &= (~0xFFF00000); //Puts 0 to C_msbs
+       t = 7;
+     }else{
+       if(C >= 0x08000000){
+         //Propagates any carry bit from C into Tr
+         Tr += 0x01;
+         C &= (~0xF8000000); //Resets the carry bit
+       }
+       if(L >= 0){
+         terminationBytes[numTerminationBytes++] = Tr;
+       }
+       L++;
+       if(Tr == 0xFF){ //Bit stuff
+         Tr = (C >>> 20); //Puts C_msbs to Tr
+         C &= (~0xFFF00000); //Puts 0 to C_msbs
+         t = 7;
+       }else{
+         Tr = (C >>> 19); //Puts C_partial to Tr
+         C &= (~0xFFF80000); //Puts 0 to C_partial
+         t = 8;
+       }
+     }
+   }
+ 
+   /**
+    * Determines the minimum number of bytes of <code>terminationBytes</code> needed to terminate
+    * the stream while assuring a complete recovering.
     *
-    * @throws Exception when some problem manipulating the stream occurs
+    * @param Cr C register for the normalization, aligned with the termination bytes
+    * @param Ar A register for the normalization, aligned with the termination bytes
+    * @return the number of bytes that should be flushed to terminate the ByteStream optimally
     */
-   private int minFlush(int NZTr, int NZt, int NZC, int NZA, int NZL, int lengthEmptyTermination) throws Exception{
-     long Cr = ((long) NZTr << 27) + ((long) NZC << NZt);
-     long Ar = (long) NZA << NZt;
+   private int minFlush(long Cr, long Ar){
      long Rf = 0;
      int s = 8;
      int Sf = 35;
  
      int necessaryBytes = 0;
      int maxNecessaryBytes = 5;
-     int cutZone = (int) stream.getLength() - lengthEmptyTermination;
-     if(maxNecessaryBytes > cutZone){
-       maxNecessaryBytes = cutZone;
-     }
-     if((lengthEmptyTermination == 0) && (((Cr >> 32) & 0xFF) == 0x00) && (NZL == -1)){
-       Cr <<= 8;
-       Ar <<= 8;
+     if(maxNecessaryBytes > numTerminationBytes){
+       maxNecessaryBytes = numTerminationBytes;
      }
      while((necessaryBytes < maxNecessaryBytes)
        && ((Rf + ((long) 1 << Sf) - 1 < Cr)
@@ -667,10 +1525,7 @@
        necessaryBytes++;
        if(necessaryBytes <= 4){
          Sf -= s;
-         long b = stream.getByte(lengthEmptyTermination + necessaryBytes - 1);
-         if(b < 0){
-           b += 256;
-         }
+         long b = terminationBytes[necessaryBytes - 1];
          Rf += b << Sf;
          if(b == 0xFF){
            s = 7;
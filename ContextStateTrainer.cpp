@@ -0,0 +1,216 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ import streams.ByteStream;
+ 
+ 
+ /**
+  * This class trains the initial states of the contexts of the <code>ArithmeticCoder</code> from a
+  * corpus of messages, so that short messages do not pay the cost of adapting from state 0. The
+  * bits of each message are run, per context, through the MQ state machine from every possible
+  * initial state and MPS at once, accumulating the cost estimated with
+  * <code>ArithmeticCoder.STATE_COST_MPS</code> and <code>STATE_COST_LPS</code>; each context
+  * is restarted at the beginning of each message, as the coder does at <code>reset</code>. The
+  * initial state and MPS with the lowest total cost are selected for each context.<br>
+  *
+  * As in the MQ coder, the state changes after the most probable symbol only when the interval is
+  * renormalized, so each candidate also keeps its own interval register. The register of the coder
+  * is shared by all contexts, hence the simulation is an approximation.<br>
+  *
+  * The result is written as a blob of 5 + numContexts bytes: the version
+  * (<code>BLOB_VERSION</code>), the number of contexts in 4 bytes (big endian) and one byte per
+  * context with (state << 1) | MPS. The blob is loaded with
+  * <code>ArithmeticCoder.loadInitialStates</code>.<br>
+  *
+  * Usage: for each message of the corpus, <code>startMessage</code> is called and then
+  * <code>addBit</code> for each bit that the models code, with its context. Finally, the blob is
+  * written with <code>writeBlob</code>.<br>
+  *
+  * Multithreading support: the object must be created and manipulated by a single thread.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class ContextStateTrainer{
+ 
+   /**
+    * Version of the format of the blob.
+    * <p>
+    * Checked when the blob is loaded.
+    */
+   public static final int BLOB_VERSION = 1;
+ 
+   /**
+    * Number of candidate initial states of each context.
+    * <p>
+    * All states with both MPSs; candidate k is state k >> 1 with MPS k & 1.
+    */
+   private static final int NUM_CANDIDATES = 2 * ArithmeticCoder.STATE_PROB.length;
+ 
+   /**
+    * Number of contexts.
+    * <p>
+    * Set when the class is instantiated.
+    */
+   private int numContexts;
+ 
+   /**
+    * Current state of each candidate of each context, as (state << 1) | MPS.
+    * <p>
+    * Candidates of context c are in [c * NUM_CANDIDATES, (c + 1) * NUM_CANDIDATES - 1].
+    */
+   private int[] candidateStates;
+ 
+   /**
+    * Interval register (A of the MQ coder) of each candidate of each context.
+    * <p>
+    * In the range [0x8000, 0xFFFF] between bits.
+    */
+   private int[] candidateIntervals;
+ 
+   /**
+    * Accumulated cost of each candidate of each context.
+    * <p>
+    * In 1/2^ArithmeticCoder.COST_BITS bits.
+    */
+   private long[] candidateCosts;
+ 
+   /**
+    * Last message in which each context has coded a bit.
+    * <p>
+    * Contexts are restarted lazily when they code their first bit of a message.
+    */
+   private int[] contextMessage;
+ 
+   /**
+    * Index of the current message.
+    * <p>
+    * Incremented by <code>startMessage</code>.
+    */
+   private int message;
+ 
+ 
+   /**
+    * Creates the trainer with no messages.
+    *
+    * @param numContexts number of contexts of the coder
+    */
+   public ContextStateTrainer(int numContexts){
+     this.numContexts = numContexts;
+     candidateStates = new int[numContexts * NUM_CANDIDATES];
+     candidateIntervals = new int[numContexts * NUM_CANDIDATES];
+     candidateCosts = new long[numContexts * NUM_CANDIDATES];
+     contextMessage = new int[numContexts];
+     for(int c = 0; c < numContexts; c++){
+       contextMessage[c] = -1;
+     }
+     message = -1;
+   }
+ 
+   /**
+    * Starts a new message of the corpus; all contexts are restarted.
+    */
+   public void startMessage(){
+     message++;
+   }
+ 
+   /**
+    * Adds a bit coded in a context in the current message.
+    *
+    * @param bit bit coded
+    * @param context context of the bit
+    */
+   public void addBit(boolean bit, int context){
+     int first = context * NUM_CANDIDATES;
+     if(contextMessage[context] != message){
+       contextMessage[context] = message;
+       for(int k = 0; k < NUM_CANDIDATES; k++){
+         candidateStates[first + k] = k;
+         candidateIntervals[first + k] = 0x8000;
+       }
+     }
+     int x = bit ? 1: 0;
+     for(int i = first; i < first + NUM_CANDIDATES; i++){
+       int state = candidateStates[i] >> 1;
+       int mps = candidateStates[i] & 1;
+       int p = ArithmeticCoder.STATE_PROB[state];
+       int a = candidateIntervals[i] - p;
+       if(x == mps){
+         candidateCosts[i] += ArithmeticCoder.STATE_COST_MPS[state];
+         if(a < 0x8000){
+           a = a < p ? p: a;
+           state = ArithmeticCoder.STATE_TRANSITIONS_MPS[state];
+         }
+       }else{
+         candidateCosts[i] += ArithmeticCoder.STATE_COST_LPS[state];
+         a = a < p ? a: p;
+         mps ^= ArithmeticCoder.STATE_CHANGE[state];
+         state = ArithmeticCoder.STATE_TRANSITIONS_LPS[state];
+       }
+       while(a < 0x8000){
+         a <<= 1;
+       }
+       candidateIntervals[i] = a;
+       candidateStates[i] = (state << 1) | mps;
+     }
+   }
+ 
+   /**
+    * Selects the initial state of each context as the candidate with the lowest cost. Contexts
+    * with no bits keep state 0 and MPS 0.
+    *
+    * @return (state << 1) | MPS of each context
+    */
+   public int[] getInitialStates(){
+     int[] initialStates = new int[numContexts];
+     for(int c = 0; c < numContexts; c++){
+       int first = c * NUM_CANDIDATES;
+       int best = 0;
+       for(int k = 1; k < NUM_CANDIDATES; k++){
+         if(candidateCosts[first + k] < candidateCosts[first + best]){
+           best = k;
+         }
+       }
+       initialStates[c] = best;
+     }
+     return(initialStates);
+   }
+ 
+   /**
+    * Gets the estimated cost of the corpus with the selected initial states.
+    *
+    * @return cost in 1/2^ArithmeticCoder.COST_BITS bits
+    */
+   public long getCost(){
+     long cost = 0;
+     int[] initialStates = getInitialStates();
+     for(int c = 0; c < numContexts; c++){
+       cost += candidateCosts[c * NUM_CANDIDATES + initialStates[c]];
+     }
+     return(cost);
+   }
+ 
+   /**
+    * Writes the blob with the selected initial states.
+    *
+    * @param stream stream where the blob is appended
+    */
+   public void writeBlob(ByteStream stream){
+     stream.putByte((byte) BLOB_VERSION);
+     for(int i = 3; i >= 0; i--){
+       stream.putByte((byte) (numContexts >>> (8 * i)));
+     }
+     int[] initialStates = getInitialStates();
+     for(int c = 0; c < numContexts; c++){
+       stream.putByte((byte) initialStates[c]);
+     }
+   }
+ }
\ No newline at end of file
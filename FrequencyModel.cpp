@@ -0,0 +1,192 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ 
+ /**
+  * This class implements an adaptive frequency model of a multi-symbol alphabet for the
+  * <code>RangeCoder</code>. The frequency of each symbol is incremented each time that the symbol
+  * is coded, and all frequencies are halved when their total exceeds <code>MAX_TOTAL</code>, so
+  * that the model adapts to changes of the statistics. The frequencies are kept in a Fenwick
+  * (binary indexed) tree, so the cumulative frequency of a symbol, the symbol of a cumulative
+  * frequency and the update after coding a symbol take log2(numSymbols) steps.<br>
+  *
+  * Multithreading support: the object must be created and manipulated by a single thread. There
+  * can be many objects of this class running simultaneously as long as a single thread manipulates
+  * each object.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class FrequencyModel{
+ 
+   /**
+    * Maximum total frequency.
+    * <p>
+    * At most 2^16, so that the precision of the <code>RangeCoder</code> is enough.
+    */
+   public static final int MAX_TOTAL = 1 << 16;
+ 
+   /**
+    * Increment of the frequency of a symbol each time that it is coded.
+    * <p>
+    * Larger increments adapt faster.
+    */
+   private static final int INCREMENT = 32;
+ 
+   /**
+    * Number of symbols of the alphabet.
+    * <p>
+    * Symbols are in the range [0, numSymbols - 1].
+    */
+   private int numSymbols;
+ 
+   /**
+    * Frequency of each symbol.
+    * <p>
+    * At least 1, so that any symbol can be coded.
+    */
+   private int[] frequencies;
+ 
+   /**
+    * Fenwick tree of the frequencies.
+    * <p>
+    * The position i (from 1) holds the sum of the frequencies of the symbols
+    * [i - (i & -i), i - 1].
+    */
+   private int[] tree;
+ 
+   /**
+    * Largest power of 2 not greater than <code>numSymbols</code>.
+    * <p>
+    * First step of the search in the tree.
+    */
+   private int topStep;
+ 
+   /**
+    * Sum of the frequencies.
+    * <p>
+    * At most <code>MAX_TOTAL</code>.
+    */
+   private int total;
+ 
+ 
+   /**
+    * Creates the model with all the symbols equiprobable.
+    *
+    * @param numSymbols number of symbols of the alphabet (256 for bytes), at most MAX_TOTAL /
+    * INCREMENT
+    */
+   public FrequencyModel(int numSymbols){
+     this.numSymbols = numSymbols;
+     frequencies = new int[numSymbols];
+     tree = new int[numSymbols + 1];
+     topStep = Integer.highestOneBit(numSymbols);
+     reset();
+   }
+ 
+   /**
+    * Sets all the symbols equiprobable.
+    */
+   public void reset(){
+     for(int s = 0; s < numSymbols; s++){
+       frequencies[s] = 1;
+     }
+     build();
+   }
+ 
+   /**
+    * Gets the sum of the frequencies.
+    *
+    * @return total frequency
+    */
+   public int getTotal(){
+     return(total);
+   }
+ 
+   /**
+    * Gets the frequency of a symbol.
+    *
+    * @param symbol symbol of the alphabet
+    * @return frequency of the symbol
+    */
+   public int getFrequency(int symbol){
+     return(frequencies[symbol]);
+   }
+ 
+   /**
+    * Gets the sum of the frequencies of the symbols lower than a symbol.
+    *
+    * @param symbol symbol of the alphabet
+    * @return cumulative frequency of the symbol
+    */
+   public int getCumulative(int symbol){
+     int sum = 0;
+     for(int i = symbol; i > 0; i -= i & -i){
+       sum += tree[i];
+     }
+     return(sum);
+   }
+ 
+   /**
+    * Finds the symbol whose interval of cumulative frequencies contains a value.
+    *
+    * @param target value in the range [0, getTotal() - 1]
+    * @return the symbol s such that getCumulative(s) <= target < getCumulative(s) + getFrequency(s)
+    */
+   public int findSymbol(int target){
+     int position = 0;
+     for(int step = topStep; step > 0; step >>= 1){
+       int next = position + step;
+       if((next <= numSymbols) && (tree[next] <= target)){
+         position = next;
+         target -= tree[next];
+       }
+     }
+     return(position);
+   }
+ 
+   /**
+    * Updates the model after coding a symbol.
+    *
+    * @param symbol symbol coded
+    */
+   public void update(int symbol){
+     frequencies[symbol] += INCREMENT;
+     total += INCREMENT;
+     if(total > MAX_TOTAL){
+       for(int s = 0; s < numSymbols; s++){
+         frequencies[s] = (frequencies[s] + 1) >> 1;
+       }
+       build();
+     }else{
+       for(int i = symbol + 1; i <= numSymbols; i += i & -i){
+         tree[i] += INCREMENT;
+       }
+     }
+   }
+ 
+   /**
+    * Builds the Fenwick tree and the total from the frequencies.
+    */
+   private void build(){
+     total = 0;
+     for(int i = 1; i <= numSymbols; i++){
+       tree[i] = frequencies[i - 1];
+       total += frequencies[i - 1];
+     }
+     for(int i = 1; i <= numSymbols; i++){
+       int parent = i + (i & -i);
+       if(parent <= numSymbols){
+         tree[parent] += tree[i];
+       }
+     }
+   }
+ }
\ No newline at end of file
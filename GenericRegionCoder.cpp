@@ -0,0 +1,420 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ 
+ /**
+  * This class implements the generic region coding of the JBIG2 standard (ITU-T T.88, section 6.2)
+  * with arithmetic coding. Each pixel of a bi-level bitmap is coded with the
+  * <code>ArithmeticCoder</code> in the context formed by the pixels of a template (templates 0 to 3,
+  * of 16, 13, 10 and 10 pixels), some of which are adaptive template (AT) pixels whose position is
+  * chosen by the encoder. Typical prediction (TPGDON) can be employed to code the rows equal to
+  * the row above with a single symbol.<br>
+  *
+  * Bitmaps are stored in packed rows of 32-bit words: the pixel x of the row y is the bit
+  * 31 - (x % 32) of the word y * rowWords + x / 32, where rowWords = (width + 31) / 32, 1 being
+  * black. The bits beyond the width must be 0. The context is not gathered pixel by pixel: the
+  * rows above are kept in sliding 32-bit windows fed from the packed words, and the fixed pixels
+  * of the template are extracted from the windows with one shift and mask per row.<br>
+  *
+  * Usage: the <code>ArithmeticCoder</code> must be created with <code>getNumContexts()</code>
+  * contexts and, as defined in the standard, all its contexts must be in the initial state when a
+  * region is started. The coder can be shared with other procedures coding to the same stream.
+  * A band of rows can also be coded as if it were a region by itself (the rows above it are
+  * taken as 0), so that the bands of a page can be decoded independently.<br>
+  *
+  * Multithreading support: the object must be created and configured by a single thread. Coding
+  * does not modify the object, so once configured it can code many regions or bands
+  * simultaneously as long as each thread employs its own <code>ArithmeticCoder</code>.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class GenericRegionCoder{
+ 
+   /**
+    * Number of bits of the context of each template.
+    * <p>
+    * Indexed by the template.
+    */
+   private static final int[] CONTEXT_BITS = {16, 13, 10, 10};
+ 
+   /**
+    * Nominal positions of the AT pixels of each template.
+    * <p>
+    * Indexed as [template][2 * i] for the x offset and [template][2 * i + 1] for the y offset of
+    * the AT pixel i (4 for template 0, 1 for the others).
+    */
+   private static final int[][] DEFAULT_AT_PIXELS = {{3, -1, -3, -1, 2, -2, -2, -2}, {3, -1}, {2, -1}, {2, -1}};
+ 
+   /**
+    * Bit of the context where each AT pixel is placed.
+    * <p>
+    * Indexed as [template][i].
+    */
+   private static final int[][] AT_CONTEXT_BITS = {{4, 10, 11, 15}, {3}, {2}, {4}};
+ 
+   /**
+    * Context employed to code the typical prediction symbol (SLTP) of each template.
+    * <p>
+    * Indexed by the template.
+    */
+   private static final int[] TYPICAL_CONTEXTS = {0x9B25, 0x0795, 0x00E5, 0x0195};
+ 
+   /**
+    * Placement of the fixed pixels of each template in the context.
+    * <p>
+    * Indexed as [template][field], the fields being: mask of the current row window, shift, mask
+    * and first context bit of the row above, and shift, mask and first context bit of the row
+    * two rows above. See <code>LOOKAHEAD</code> for the layout of the windows.
+    */
+   private static final int[][] TEMPLATE_LAYOUT = {
+     {0xF, 2, 0x1F, 5, 3, 0x7, 12},
+     {0x7, 2, 0x1F, 4, 2, 0xF, 9},
+     {0x3, 3, 0xF, 3, 3, 0x7, 7},
+     {0xF, 3, 0x1F, 5, 0, 0, 0}};
+ 
+   /**
+    * Number of pixels at the right of the current pixel held in the windows of the rows above.
+    * <p>
+    * The bit k of the window of a row above holds the pixel x + LOOKAHEAD - k of that row. The
+    * bit k of the window of the current row holds the pixel x - 1 - k.
+    */
+   private static final int LOOKAHEAD = 4;
+ 
+   /**
+    * Template employed.
+    * <p>
+    * In the range [0, 3].
+    */
+   private int template;
+ 
+   /**
+    * Indicates whether typical prediction (TPGDON) is employed.
+    * <p>
+    * Must be the same when encoding and decoding.
+    */
+   private boolean typicalPrediction;
+ 
+   /**
+    * Offsets of the AT pixels.
+    * <p>
+    * Pairs of x and y offsets, as in <code>DEFAULT_AT_PIXELS</code>.
+    */
+   private int[] atPixels;
+ 
+   /**
+    * Window from which each AT pixel is extracted.
+    * <p>
+    * 0 for the current row, 1 and 2 for the rows above, and -1 when the pixel is out of the
+    * windows and is read from the bitmap.
+    */
+   private int[] atWindows;
+ 
+   /**
+    * Shift that brings each AT pixel to the least significant bit of its window.
+    * <p>
+    * Not employed when the window is -1.
+    */
+   private int[] atShifts;
+ 
+ 
+   /**
+    * Creates a coder with the nominal AT pixels of the template.
+    *
+    * @param template template employed, in the range [0, 3]
+    * @param typicalPrediction true to employ typical prediction (TPGDON)
+    */
+   public GenericRegionCoder(int template, boolean typicalPrediction){
+     this.template = template;
+     this.typicalPrediction = typicalPrediction;
+     placeATPixels(DEFAULT_AT_PIXELS[template]);
+   }
+ 
+   /**
+    * Sets the position of the AT pixels. They must be above the current pixel or at its left in
+    * the current row, since the others have not been decoded yet (T.88, 6.2.5.4).
+    *
+    * @param atPixels pairs of x and y offsets of the AT pixels, 4 pairs for template 0 and 1 pair
+    * for the others
+    * @throws Exception when some AT pixel is not causal
+    */
+   public void setATPixels(int[] atPixels) throws Exception{
+     int numAT = AT_CONTEXT_BITS[template].length;
+     for(int i = 0; i < numAT; i++){
+       int dx = atPixels[2 * i];
+       int dy = atPixels[2 * i + 1];
+       if((dy > 0) || ((dy == 0) && (dx >= 0))){
+         throw new Exception("AT pixel (" + dx + ", " + dy + ") is not causal.");
+       }
+     }
+     placeATPixels(atPixels);
+   }
+ 
+   /**
+    * Computes the windows and the shifts of the AT pixels, which are not validated.
+    *
+    * @param atPixels pairs of x and y offsets of the AT pixels
+    */
+   private void placeATPixels(int[] atPixels){
+     int numAT = AT_CONTEXT_BITS[template].length;
+     this.atPixels = new int[numAT * 2];
+     this.atWindows = new int[numAT];
+     this.atShifts = new int[numAT];
+     for(int i = 0; i < numAT; i++){
+       int dx = atPixels[2 * i];
+       int dy = atPixels[2 * i + 1];
+       this.atPixels[2 * i] = dx;
+       this.atPixels[2 * i + 1] = dy;
+       if((dy == 0) && (dx < 0) && (dx >= -32)){
+         atWindows[i] = 0;
+         atShifts[i] = -dx - 1;
+       }else if(((dy == -1) || (dy == -2)) && (dx <= LOOKAHEAD) && (dx > LOOKAHEAD - 32)){
+         atWindows[i] = -dy;
+         atShifts[i] = LOOKAHEAD - dx;
+       }else{
+         atWindows[i] = -1;
+       }
+     }
+   }
+ 
+   /**
+    * Gets the number of contexts that the <code>ArithmeticCoder</code> must have.
+    *
+    * @return 2 raised to the number of bits of the context of the template
+    */
+   public int getNumContexts(){
+     return(1 << CONTEXT_BITS[template]);
+   }
+ 
+   /**
+    * Gets the number of words of each row of a packed bitmap.
+    *
+    * @param width width of the bitmap
+    * @return (width + 31) / 32
+    */
+   public static int getRowWords(int width){
+     return((width + 31) >> 5);
+   }
+ 
+   /**
+    * Encodes a bitmap. The coder is not terminated, so that other data can follow.
+    *
+    * @param bitmap packed rows of the bitmap
+    * @param width width of the bitmap
+    * @param height height of the bitmap
+    * @param coder coder employed, already restarted for encoding
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void encode(int[] bitmap, int width, int height, BinaryCoder coder) throws Exception{
+     code(coder, bitmap, width, 0, height, true);
+   }
+ 
+   /**
+    * Encodes a band of rows of a bitmap as a region by itself: the rows above the band are taken
+    * as 0.
+    *
+    * @param bitmap packed rows of the bitmap
+    * @param width width of the bitmap
+    * @param firstRow first row of the band
+    * @param numRows number of rows of the band
+    * @param coder coder employed, already restarted for encoding
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void encode(int[] bitmap, int width, int firstRow, int numRows, BinaryCoder coder)
+   throws Exception{
+     code(coder, bitmap, width, firstRow, firstRow + numRows, true);
+   }
+ 
+   /**
+    * Decodes a bitmap.
+    *
+    * @param coder coder employed, already restarted for decoding
+    * @param width width of the bitmap
+    * @param height height of the bitmap
+    * @param bitmap array of at least height * getRowWords(width) words where the packed rows of
+    * the bitmap are stored
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void decode(BinaryCoder coder, int width, int height, int[] bitmap) throws Exception{
+     code(coder, bitmap, width, 0, height, false);
+   }
+ 
+   /**
+    * Decodes a band of rows of a bitmap encoded as a region by itself. Only the rows of the band
+    * are accessed.
+    *
+    * @param coder coder employed, already restarted for decoding
+    * @param width width of the bitmap
+    * @param firstRow first row of the band
+    * @param numRows number of rows of the band
+    * @param bitmap packed rows of the bitmap
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void decode(BinaryCoder coder, int width, int firstRow, int numRows, int[] bitmap)
+   throws Exception{
+     code(coder, bitmap, width, firstRow, firstRow + numRows, false);
+   }
+ 
+   /**
+    * Encodes or decodes a band of rows of a bitmap, the rows above the band being taken as 0.
+    *
+    * @param coder coder employed
+    * @param bitmap packed rows of the bitmap
+    * @param width width of the bitmap
+    * @param firstRow first row of the band (inclusive)
+    * @param endRow last row of the band (exclusive)
+    * @param encoding true to encode, false to decode
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   private void code(BinaryCoder coder, int[] bitmap, int width, int firstRow, int endRow,
+   boolean encoding) throws Exception{
+     int rowWords = getRowWords(width);
+     int[] layout = TEMPLATE_LAYOUT[template];
+     int row0Mask = layout[0];
+     int row1Shift = layout[1];
+     int row1Mask = layout[2];
+     int row1Bit = layout[3];
+     int row2Shift = layout[4];
+     int row2Mask = layout[5];
+     int row2Bit = layout[6];
+     int[] atBits = AT_CONTEXT_BITS[template];
+     int numAT = atBits.length;
+     int typicalContext = TYPICAL_CONTEXTS[template];
+     boolean typical = false;
+ 
+     for(int y = firstRow; y < endRow; y++){
+       int offset = y * rowWords;
+       if(typicalPrediction){
+         if(encoding){
+           boolean rowTypical = equalsRowAbove(bitmap, offset, rowWords, y > firstRow);
+           coder.encodeBitContext(rowTypical != typical, typicalContext);
+           typical = rowTypical;
+         }else if(coder.decodeBitContext(typicalContext)){
+           typical = !typical;
+         }
+         if(typical){
+           if(!encoding){
+             for(int w = 0; w < rowWords; w++){
+               bitmap[offset + w] = y > firstRow ? bitmap[offset - rowWords + w]: 0;
+             }
+           }
+           continue;
+         }
+       }
+ 
+       //Windows of the rows above, loaded up to the pixel LOOKAHEAD
+       int offset1 = offset - rowWords;
+       int offset2 = offset - 2 * rowWords;
+       boolean above1 = y - 1 >= firstRow;
+       boolean above2 = y - 2 >= firstRow;
+       int fetch1 = above1 ? bitmap[offset1]: 0;
+       int fetch2 = above2 ? bitmap[offset2]: 0;
+       int window1 = fetch1 >>> (31 - LOOKAHEAD);
+       int window2 = fetch2 >>> (31 - LOOKAHEAD);
+       fetch1 <<= LOOKAHEAD + 1;
+       fetch2 <<= LOOKAHEAD + 1;
+       int window0 = 0;
+       int fetch0 = encoding ? bitmap[offset]: 0;
+       int decoded = 0;
+ 
+       for(int x = 0; x < width; x++){
+         int context = (window0 & row0Mask) | (((window1 >> row1Shift) & row1Mask) << row1Bit)
+           | (((window2 >> row2Shift) & row2Mask) << row2Bit);
+         for(int i = 0; i < numAT; i++){
+           int pixel;
+           switch(atWindows[i]){
+           case 0:
+             pixel = window0 >> atShifts[i];
+             break;
+           case 1:
+             pixel = window1 >> atShifts[i];
+             break;
+           case 2:
+             pixel = window2 >> atShifts[i];
+             break;
+           default:
+             pixel = getPixel(bitmap, width, firstRow, endRow, x + atPixels[2 * i], y + atPixels[2 * i + 1]);
+           }
+           context |= (pixel & 1) << atBits[i];
+         }
+ 
+         int bit;
+         if(encoding){
+           bit = fetch0 >>> 31;
+           coder.encodeBitContext(bit != 0, context);
+           fetch0 <<= 1;
+           if(((x + 1) & 31) == 0){
+             fetch0 = (x + 1) >> 5 < rowWords ? bitmap[offset + ((x + 1) >> 5)]: 0;
+           }
+         }else{
+           bit = coder.decodeBitContext(context) ? 1: 0;
+           decoded = (decoded << 1) | bit;
+           if((x & 31) == 31){
+             bitmap[offset + (x >> 5)] = decoded;
+             decoded = 0;
+           }
+         }
+         window0 = (window0 << 1) | bit;
+ 
+         //Slides the windows of the rows above
+         window1 = (window1 << 1) | (fetch1 >>> 31);
+         window2 = (window2 << 1) | (fetch2 >>> 31);
+         fetch1 <<= 1;
+         fetch2 <<= 1;
+         int next = x + LOOKAHEAD + 2;
+         if((next & 31) == 0){
+           int word = next >> 5;
+           fetch1 = above1 && (word < rowWords) ? bitmap[offset1 + word]: 0;
+           fetch2 = above2 && (word < rowWords) ? bitmap[offset2 + word]: 0;
+         }
+       }
+       if(!encoding && ((width & 31) != 0)){
+         bitmap[offset + (width >> 5)] = decoded << (32 - (width & 31));
+       }
+     }
+   }
+ 
+   /**
+    * Checks whether a row is equal to the row above (or is empty, for the first row of a band).
+    *
+    * @param bitmap packed rows of the bitmap
+    * @param offset position of the first word of the row
+    * @param rowWords number of words of each row
+    * @param hasRowAbove false for the first row of a band
+    * @return true when the row is equal to the row above
+    */
+   private static boolean equalsRowAbove(int[] bitmap, int offset, int rowWords, boolean hasRowAbove){
+     for(int w = 0; w < rowWords; w++){
+       if(bitmap[offset + w] != (hasRowAbove ? bitmap[offset - rowWords + w]: 0)){
+         return(false);
+       }
+     }
+     return(true);
+   }
+ 
+   /**
+    * Gets a pixel of a band of a bitmap, 0 when it is outside the band.
+    *
+    * @param bitmap packed rows of the bitmap
+    * @param width width of the bitmap
+    * @param firstRow first row of the band (inclusive)
+    * @param endRow last row of the band (exclusive)
+    * @param x column of the pixel
+    * @param y row of the pixel
+    * @return 0 or 1
+    */
+   private static int getPixel(int[] bitmap, int width, int firstRow, int endRow, int x, int y){
+     if((x < 0) || (x >= width) || (y < firstRow) || (y >= endRow)){
+       return(0);
+     }
+     return((bitmap[y * getRowWords(width) + (x >> 5)] >>> (31 - (x & 31))) & 1);
+   }
+ }
\ No newline at end of file
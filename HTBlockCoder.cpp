@@ -0,0 +1,813 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ import streams.ByteStream;
+ 
+ 
+ /**
+  * This class implements a high-throughput block coder in the spirit of the HTJ2K block coder
+  * (JPEG2000 part 15). Instead of coding bit planes with an arithmetic coder, the code-block is
+  * coded in a single pass over quads of 2x2 samples with three simple codes:<br>
+  * - MEL: adaptive run-length code (<code>MELCoder</code>) that signals whether the quads without
+  *   significant neighbours are significant.<br>
+  * - VLC: variable length codes, selected by the significance of the neighbouring quads, for the
+  *   significance pattern of each quad, followed by the number of magnitude bits of the quad
+  *   (U-VLC code).<br>
+  * - MagSgn: raw magnitude and sign bits of the significant samples.<br>
+  *
+  * The MagSgn and MEL codes are written forwards and the VLC code backwards from the end of the
+  * code-block, so that the three of them are read independently. The segment is:
+  * MagSgn bytes, MEL bytes, VLC bytes (reversed) and 3 bytes with the length of the MEL and VLC
+  * bytes (7 bits each). Bytes are stuffed so that no marker (0xFF followed by a byte greater
+  * than 0x8F) appears.<br>
+  *
+  * The code-block is coded in a single coding pass, so the stream cannot be truncated. The
+  * subband and the options are not employed.<br>
+  *
+  * Usage: the same object should be employed to code all the code-blocks, since the buffers are
+  * reused. Samples are given in two's complement, row by row.<br>
+  *
+  * Multithreading support: the object must be created and manipulated by a single thread. There
+  * can be many objects of this class running simultaneously as long as a single thread manipulates
+  * each object.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class HTBlockCoder implements BlockCoder{
+ 
+   /**
+    * Number of contexts of the VLC code.
+    * <p>
+    * Bit 0 of the context is the significance of the quad at the left, bit 1 the one of the quad
+    * above, and bit 2 the one of the quads above at the left and at the right.
+    */
+   private static final int NUM_VLC_CONTEXTS = 8;
+ 
+   /**
+    * Maximum length of a codeword of the VLC code.
+    * <p>
+    * The codewords obtained from <code>SIGNIFICANCE_PROBABILITIES</code> have at most 7 bits, so
+    * each decoding table has 128 entries. Checked when the codewords are built.
+    */
+   private static final int MAX_VLC_LENGTH = 7;
+ 
+   /**
+    * Probability that a sample is significant for each context of the VLC code.
+    * <p>
+    * The VLC code of each context is built for this probability. In context 0 the quad is known
+    * to be significant (signalled by the MEL code).
+    */
+   private static final float[] SIGNIFICANCE_PROBABILITIES = {0.25f, 0.45f, 0.45f, 0.6f, 0.35f, 0.55f, 0.55f, 0.7f};
+ 
+   /**
+    * VLC codeword of each context and significance pattern.
+    * <p>
+    * Indexed as [context][pattern]. The 16 least significant bits are the codeword, bit-reversed
+    * to be written from the least significant bit, and the next bits its length.
+    */
+   private static final int[][] VLC_CODEWORDS = buildVLCCodewords();
+ 
+   /**
+    * Decoding table of the VLC code of each context.
+    * <p>
+    * Indexed as [context][next MAX_VLC_LENGTH bits]. The 4 least significant bits of each entry
+    * are the significance pattern and the next bits the length of its codeword.
+    */
+   private static final int[][] VLC_TABLES = buildVLCTables();
+ 
+   /**
+    * Writer of the MagSgn bits.
+    * <p>
+    * A byte after a 0xFF byte carries 7 bits.
+    */
+   private BitWriter magSgnWriter = new BitWriter(0xFE);
+ 
+   /**
+    * Coder of the MEL events.
+    * <p>
+    * An event 1 indicates that a quad without significant neighbours is significant.
+    */
+   private MELCoder mel = new MELCoder();
+ 
+   /**
+    * Stream where the MEL bytes are written before being appended to the code-block.
+    * <p>
+    * Emptied for each code-block.
+    */
+   private ByteStream melStream = new ByteStream();
+ 
+   /**
+    * Writer of the VLC bits.
+    * <p>
+    * A byte after a byte greater than 0x8F carries 7 bits, so that the reversed bytes contain no
+    * markers.
+    */
+   private BitWriter vlcWriter = new BitWriter(0x8F);
+ 
+   /**
+    * Reader of the MagSgn bits.
+    * <p>
+    * Reads forwards.
+    */
+   private BitReader magSgnReader = new BitReader();
+ 
+   /**
+    * Reader of the VLC bits.
+    * <p>
+    * Reads backwards.
+    */
+   private BitReader vlcReader = new BitReader();
+ 
+   /**
+    * Significance pattern of the quads of the row above, with one quad of padding at each side.
+    * <p>
+    * The quad qx is at position qx + 1.
+    */
+   private int[] aboveRho = new int[32 + 2];
+ 
+   /**
+    * Significance pattern of the quads of the current row, as <code>aboveRho</code>.
+    * <p>
+    * Swapped with <code>aboveRho</code> at the end of each row.
+    */
+   private int[] currentRho = new int[32 + 2];
+ 
+   /**
+    * Number of magnitude bit planes of the current code-block.
+    * <p>
+    * 0 when all samples are 0.
+    */
+   private int numBitPlanes;
+ 
+   /**
+    * Number of coding passes of the current code-block.
+    * <p>
+    * 1, or 0 when all samples are 0.
+    */
+   private int numPasses;
+ 
+   /**
+    * End of the coding pass of the last code-block encoded.
+    * <p>
+    * See <code>getPassEnds</code>.
+    */
+   private int[] passEnds = new int[1];
+ 
+ 
+   /**
+    * Creates a coder for code-blocks of any size.
+    */
+   public HTBlockCoder(){
+   }
+ 
+   /**
+    * No options are supported, so the options are ignored.
+    *
+    * @param options ignored
+    */
+   public void setOptions(int options){
+   }
+ 
+   /**
+    * Encodes a code-block.
+    *
+    * @param samples samples of the code-block, row by row, in two's complement
+    * @param width width of the code-block
+    * @param height height of the code-block
+    * @param subband ignored
+    * @param stream stream where the code-block is written, from its first byte (the previous
+    * content of the stream is removed)
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void encode(int[] samples, int width, int height, int subband, ByteStream stream) throws Exception{
+     stream.removeBytes((int) stream.getLength());
+     int maxMagnitude = 0;
+     for(int s = 0; s < width * height; s++){
+       maxMagnitude |= samples[s] < 0 ? -samples[s]: samples[s];
+     }
+     numBitPlanes = 32 - Integer.numberOfLeadingZeros(maxMagnitude);
+     numPasses = numBitPlanes > 0 ? 1: 0;
+     passEnds[0] = 0;
+     if(numBitPlanes == 0){
+       return;
+     }
+ 
+     prepare(width);
+     magSgnWriter.restart();
+     vlcWriter.restart();
+     melStream.removeBytes((int) melStream.getLength());
+     mel.changeStream(melStream);
+     mel.restartEncoding();
+     int quadsWide = (width + 1) >> 1;
+     for(int y = 0; y < height; y += 2){
+       for(int qx = 0; qx < quadsWide; qx++){
+         int x = qx * 2;
+         int rho = 0;
+         int exponent = 0;
+         for(int i = 0; i < 4; i++){
+           int sx = x + (i >> 1);
+           int sy = y + (i & 1);
+           if((sx < width) && (sy < height)){
+             int sample = samples[sy * width + sx];
+             if(sample != 0){
+               rho |= 1 << i;
+               int sampleExponent = 32 - Integer.numberOfLeadingZeros(sample < 0 ? -sample: sample);
+               exponent = sampleExponent > exponent ? sampleExponent: exponent;
+             }
+           }
+         }
+ 
+         int context = quadContext(qx);
+         if(context == 0){
+           mel.encodeBit(rho != 0);
+         }
+         currentRho[qx + 1] = rho;
+         if(rho != 0){
+           int codeword = VLC_CODEWORDS[context][rho];
+           vlcWriter.putBits(codeword & 0xFFFF, codeword >>> 16);
+           encodeUVLC(exponent);
+           for(int i = 0; i < 4; i++){
+             if(((rho >> i) & 1) != 0){
+               int sample = samples[(y + (i & 1)) * width + x + (i >> 1)];
+               magSgnWriter.putBits((sample < 0 ? -sample: sample) - 1, exponent);
+               magSgnWriter.putBits(sample < 0 ? 1: 0, 1);
+             }
+           }
+         }else if(context != 0){
+           int codeword = VLC_CODEWORDS[context][0];
+           vlcWriter.putBits(codeword & 0xFFFF, codeword >>> 16);
+         }
+       }
+       swapRows();
+     }
+     mel.terminate();
+     magSgnWriter.flush();
+     vlcWriter.flush();
+ 
+     for(int b = 0; b < magSgnWriter.length; b++){
+       stream.putByte(magSgnWriter.buffer[b]);
+     }
+     int melLength = (int) melStream.getLength();
+     for(int b = 0; b < melLength; b++){
+       stream.putByte(melStream.getByte(b));
+     }
+     for(int b = vlcWriter.length - 1; b >= 0; b--){
+       stream.putByte(vlcWriter.buffer[b]);
+     }
+     SegmentLength.write(stream, melLength + vlcWriter.length);
+     passEnds[0] = (int) stream.getLength();
+   }
+ 
+   /**
+    * Decodes a code-block.
+    *
+    * @param stream stream from which the code-block is read
+    * @param width width of the code-block
+    * @param height height of the code-block
+    * @param subband ignored
+    * @param numBitPlanes number of magnitude bit planes of the code-block
+    * @param numPasses number of coding passes to decode, 0 or 1
+    * @param passEnds end of the coding pass in the stream, or null when the code-block ends at the
+    * end of the stream
+    * @param samples array where the samples are stored, row by row, in two's complement
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void decode(ByteStream stream, int width, int height, int subband, int numBitPlanes,
+   int numPasses, int[] passEnds, int[] samples) throws Exception{
+     this.numBitPlanes = numBitPlanes;
+     this.numPasses = numPasses;
+     for(int s = 0; s < width * height; s++){
+       samples[s] = 0;
+     }
+     if(numPasses <= 0){
+       return;
+     }
+ 
+     int end = passEnds != null ? passEnds[0]: (int) stream.getLength();
+     int suffixEnd = end - SegmentLength.NUM_BYTES;
+     if(suffixEnd < 0){
+       throw new Exception("Code-block segment too short.");
+     }
+     int suffixBegin = suffixEnd - SegmentLength.read(stream, suffixEnd);
+     if(suffixBegin < 0){
+       throw new Exception("Wrong length of the MEL and VLC segments.");
+     }
+     magSgnReader.restart(stream, 0, 1, suffixBegin, 0xFE);
+     mel.changeStream(stream);
+     mel.restartDecoding(suffixBegin, suffixEnd);
+     vlcReader.restart(stream, suffixEnd - 1, -1, suffixBegin - 1, 0x8F);
+ 
+     prepare(width);
+     int quadsWide = (width + 1) >> 1;
+     for(int y = 0; y < height; y += 2){
+       for(int qx = 0; qx < quadsWide; qx++){
+         int context = quadContext(qx);
+         int rho = 0;
+         if((context != 0) || mel.decodeBit()){
+           int entry = VLC_TABLES[context][vlcReader.peek(MAX_VLC_LENGTH)];
+           vlcReader.skip(entry >> 4);
+           rho = entry & 0xF;
+         }
+         currentRho[qx + 1] = rho;
+         if(rho != 0){
+           int exponent = decodeUVLC();
+           int x = qx * 2;
+           for(int i = 0; i < 4; i++){
+             if(((rho >> i) & 1) != 0){
+               int magnitude = magSgnReader.getBits(exponent) + 1;
+               int sy = y + (i & 1);
+               int sx = x + (i >> 1);
+               if((sx >= width) || (sy >= height)){
+                 throw new Exception("Significant sample outside the code-block.");
+               }
+               samples[sy * width + sx] = magSgnReader.getBits(1) != 0 ? -magnitude: magnitude;
+             }
+           }
+         }
+       }
+       swapRows();
+     }
+   }
+ 
+   /**
+    * Gets the number of magnitude bit planes of the last code-block coded.
+    *
+    * @return number of bit planes
+    */
+   public int getNumBitPlanes(){
+     return(numBitPlanes);
+   }
+ 
+   /**
+    * Gets the number of coding passes of the last code-block coded.
+    *
+    * @return number of coding passes
+    */
+   public int getNumPasses(){
+     return(numPasses);
+   }
+ 
+   /**
+    * Gets the end of the coding pass of the last code-block encoded, in bytes from the beginning
+    * of the code-block.
+    *
+    * @return array whose first <code>getNumPasses()</code> positions are valid. It is overwritten
+    * when the next code-block is encoded
+    */
+   public int[] getPassEnds(){
+     return(passEnds);
+   }
+ 
+   /**
+    * Computes the VLC context of a quad of the current row from the quads already coded.
+    *
+    * @param qx column of the quad
+    * @return context in the range [0, NUM_VLC_CONTEXTS - 1]
+    */
+   private int quadContext(int qx){
+     return((currentRho[qx] != 0 ? 1: 0) | (aboveRho[qx + 1] != 0 ? 2: 0)
+       | ((aboveRho[qx] | aboveRho[qx + 2]) != 0 ? 4: 0));
+   }
+ 
+   /**
+    * Encodes the number of magnitude bits of a significant quad with the U-VLC code: 1, 01,
+    * 001 followed by 1 bit, and 000 followed by 5 bits.
+    *
+    * @param exponent number of bits of the largest magnitude of the quad, in the range [1, 31]
+    */
+   private void encodeUVLC(int exponent){
+     if(exponent == 1){
+       vlcWriter.putBits(1, 1);
+     }else if(exponent == 2){
+       vlcWriter.putBits(2, 2);
+     }else if(exponent <= 4){
+       vlcWriter.putBits(4 | ((exponent - 3) << 3), 4);
+     }else{
+       vlcWriter.putBits((exponent - 5) << 3, 8);
+     }
+   }
+ 
+   /**
+    * Decodes the number of magnitude bits of a significant quad (see <code>encodeUVLC</code>).
+    *
+    * @return number of bits of the largest magnitude of the quad
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   private int decodeUVLC() throws Exception{
+     int prefix = vlcReader.peek(3);
+     if((prefix & 1) != 0){
+       vlcReader.skip(1);
+       return(1);
+     }
+     if((prefix & 2) != 0){
+       vlcReader.skip(2);
+       return(2);
+     }
+     vlcReader.skip(3);
+     if(prefix != 0){
+       return(3 + vlcReader.getBits(1));
+     }
+     return(5 + vlcReader.getBits(5));
+   }
+ 
+   /**
+    * Clears the significance of the quad rows for a code-block.
+    *
+    * @param width width of the code-block
+    */
+   private void prepare(int width){
+     int length = ((width + 1) >> 1) + 2;
+     if(aboveRho.length < length){
+       aboveRho = new int[length];
+       currentRho = new int[length];
+     }else{
+       for(int q = 0; q < length; q++){
+         aboveRho[q] = 0;
+         currentRho[q] = 0;
+       }
+     }
+   }
+ 
+   /**
+    * Makes the current quad row the row above. The padding quads remain insignificant.
+    */
+   private void swapRows(){
+     int[] tmp = aboveRho;
+     aboveRho = currentRho;
+     currentRho = tmp;
+   }
+ 
+   /**
+    * Builds the VLC codewords of all the contexts. The codewords of each context are the
+    * canonical Huffman code for patterns of 4 samples that are significant independently with
+    * the probability of the context.
+    *
+    * @return array of codewords (see <code>VLC_CODEWORDS</code>)
+    */
+   private static int[][] buildVLCCodewords(){
+     int[][] codewords = new int[NUM_VLC_CONTEXTS][16];
+     for(int context = 0; context < NUM_VLC_CONTEXTS; context++){
+       float p = SIGNIFICANCE_PROBABILITIES[context];
+       float[] weights = new float[16];
+       for(int rho = 0; rho < 16; rho++){
+         int bits = Integer.bitCount(rho);
+         weights[rho] = (float) (Math.pow(p, bits) * Math.pow(1 - p, 4 - bits));
+       }
+       if(context == 0){
+         weights[0] = 0;
+       }
+       int[] lengths = huffmanLengths(weights);
+       for(int rho = 0; rho < 16; rho++){
+         if(lengths[rho] > MAX_VLC_LENGTH){
+           throw new IllegalStateException("VLC codeword longer than MAX_VLC_LENGTH.");
+         }
+       }
+ 
+       //Canonical codewords, in order of length and pattern
+       int code = 0;
+       int previousLength = 0;
+       for(int length = 1; length <= MAX_VLC_LENGTH; length++){
+         for(int rho = 0; rho < 16; rho++){
+           if(lengths[rho] == length){
+             code <<= length - previousLength;
+             previousLength = length;
+             int reversed = Integer.reverse(code) >>> (32 - length);
+             codewords[context][rho] = reversed | (length << 16);
+             code++;
+           }
+         }
+       }
+     }
+     return(codewords);
+   }
+ 
+   /**
+    * Builds the decoding tables of the VLC code of all the contexts.
+    *
+    * @return array of tables (see <code>VLC_TABLES</code>)
+    */
+   private static int[][] buildVLCTables(){
+     int[][] tables = new int[NUM_VLC_CONTEXTS][1 << MAX_VLC_LENGTH];
+     for(int context = 0; context < NUM_VLC_CONTEXTS; context++){
+       for(int rho = 0; rho < 16; rho++){
+         int codeword = VLC_CODEWORDS[context][rho];
+         int length = codeword >>> 16;
+         if(length > 0){
+           for(int fill = 0; fill < 1 << (MAX_VLC_LENGTH - length); fill++){
+             tables[context][(codeword & 0xFFFF) | (fill << length)] = rho | (length << 4);
+           }
+         }
+       }
+     }
+     return(tables);
+   }
+ 
+   /**
+    * Computes the codeword lengths of the Huffman code of a set of symbols.
+    *
+    * @param weights weight of each symbol. Symbols of weight 0 get no codeword
+    * @return length of the codeword of each symbol (0 for the symbols of weight 0)
+    */
+   private static int[] huffmanLengths(float[] weights){
+     int numSymbols = weights.length;
+     int[] lengths = new int[numSymbols];
+     float[] nodeWeights = new float[numSymbols];
+     int[] nodeSymbols = new int[numSymbols]; //Bit mask of the symbols below each node
+     int numNodes = 0;
+     for(int symbol = 0; symbol < numSymbols; symbol++){
+       if(weights[symbol] > 0){
+         nodeWeights[numNodes] = weights[symbol];
+         nodeSymbols[numNodes++] = 1 << symbol;
+       }
+     }
+     while(numNodes > 1){
+       //Merges the two lightest nodes
+       int first = 0;
+       for(int node = 1; node < numNodes; node++){
+         if(nodeWeights[node] < nodeWeights[first]){
+           first = node;
+         }
+       }
+       int second = first == 0 ? 1: 0;
+       for(int node = 0; node < numNodes; node++){
+         if((node != first) && (nodeWeights[node] < nodeWeights[second])){
+           second = node;
+         }
+       }
+       for(int symbol = 0; symbol < numSymbols; symbol++){
+         if((((nodeSymbols[first] | nodeSymbols[second]) >> symbol) & 1) != 0){
+           lengths[symbol]++;
+         }
+       }
+       nodeWeights[first] += nodeWeights[second];
+       nodeSymbols[first] |= nodeSymbols[second];
+       numNodes--;
+       nodeWeights[second] = nodeWeights[numNodes];
+       nodeSymbols[second] = nodeSymbols[numNodes];
+     }
+     return(lengths);
+   }
+ 
+   /**
+    * Packs bits from the least significant bit of each byte, stuffing a 0 bit in the most
+    * significant bit of the bytes that follow a byte greater than a threshold.
+    */
+   private static final class BitWriter{
+ 
+     /**
+      * Bytes written.
+      * <p>
+      * Only the first <code>length</code> positions are valid. Grown when needed.
+      */
+     byte[] buffer = new byte[1024];
+ 
+     /**
+      * Number of bytes written.
+      * <p>
+      * Not including the bits pending in <code>bits</code>.
+      */
+     int length = 0;
+ 
+     /**
+      * Bits not written yet.
+      * <p>
+      * The first bit is the least significant one.
+      */
+     private long bits = 0;
+ 
+     /**
+      * Number of bits in <code>bits</code>.
+      * <p>
+      * Less than 8 between calls.
+      */
+     private int numBits = 0;
+ 
+     /**
+      * Last byte written.
+      * <p>
+      * 0 at the beginning.
+      */
+     private int lastByte = 0;
+ 
+     /**
+      * Bytes following a byte greater than this threshold carry 7 bits.
+      * <p>
+      * 0xFE to stuff after 0xFF, or 0x8F to stuff after any byte that can follow 0xFF in a marker.
+      */
+     private int stuffThreshold;
+ 
+ 
+     /**
+      * Creates a writer.
+      *
+      * @param stuffThreshold bytes following a byte greater than this threshold carry 7 bits
+      */
+     BitWriter(int stuffThreshold){
+       this.stuffThreshold = stuffThreshold;
+     }
+ 
+     /**
+      * Discards the bytes written.
+      */
+     void restart(){
+       length = 0;
+       bits = 0;
+       numBits = 0;
+       lastByte = 0;
+     }
+ 
+     /**
+      * Writes the least significant bits of a value, from the least significant one.
+      *
+      * @param value value whose bits are written
+      * @param n number of bits, in the range [0, 32]
+      */
+     void putBits(int value, int n){
+       bits |= ((long) value & ((1L << n) - 1)) << numBits;
+       numBits += n;
+       while(numBits >= 8){
+         putByte();
+       }
+     }
+ 
+     /**
+      * Writes the pending bits padded with 0s. When the last byte is 0xFF, a byte 0 is added so
+      * that the bytes that follow the ones of this writer cannot form a marker.
+      */
+     void flush(){
+       if(numBits > 0){
+         putByte();
+       }
+       if(lastByte == 0xFF){
+         putByte();
+       }
+       bits = 0;
+       numBits = 0;
+     }
+ 
+     /**
+      * Writes the next byte from the pending bits.
+      */
+     private void putByte(){
+       int n = lastByte > stuffThreshold ? 7: 8;
+       int b = (int) bits & ((1 << n) - 1);
+       bits >>>= n;
+       numBits = numBits > n ? numBits - n: 0;
+       if(length == buffer.length){
+         byte[] newBuffer = new byte[buffer.length * 2];
+         System.arraycopy(buffer, 0, newBuffer, 0, length);
+         buffer = newBuffer;
+       }
+       buffer[length++] = (byte) b;
+       lastByte = b;
+     }
+   }
+ 
+   /**
+    * Reads the bits packed by a <code>BitWriter</code> from a stream, forwards or backwards.
+    * Beyond the limit, bytes are read as 0.
+    */
+   private static final class BitReader{
+ 
+     /**
+      * Stream from which the bits are read.
+      * <p>
+      * Only read.
+      */
+     private ByteStream stream = null;
+ 
+     /**
+      * Position of the next byte read.
+      * <p>
+      * Moves by <code>step</code> after each byte.
+      */
+     private int position;
+ 
+     /**
+      * Direction in which the bytes are read.
+      * <p>
+      * 1 forwards, -1 backwards.
+      */
+     private int step;
+ 
+     /**
+      * First position that is not read.
+      * <p>
+      * Reached moving by <code>step</code>.
+      */
+     private int limit;
+ 
+     /**
+      * Bits read and not consumed yet.
+      * <p>
+      * The next bit is the least significant one.
+      */
+     private long bits;
+ 
+     /**
+      * Number of bits in <code>bits</code>.
+      * <p>
+      * At most 63.
+      */
+     private int numBits;
+ 
+     /**
+      * Last byte read.
+      * <p>
+      * 0 at the beginning.
+      */
+     private int lastByte;
+ 
+     /**
+      * Bytes following a byte greater than this threshold carry 7 bits.
+      * <p>
+      * As the threshold of the <code>BitWriter</code>.
+      */
+     private int stuffThreshold;
+ 
+ 
+     /**
+      * Starts reading a segment of a stream.
+      *
+      * @param stream stream from which the bits are read
+      * @param position position of the first byte
+      * @param step 1 to read forwards, -1 to read backwards
+      * @param limit first position that is not read
+      * @param stuffThreshold bytes following a byte greater than this threshold carry 7 bits
+      */
+     void restart(ByteStream stream, int position, int step, int limit, int stuffThreshold){
+       this.stream = stream;
+       this.position = position;
+       this.step = step;
+       this.limit = limit;
+       this.stuffThreshold = stuffThreshold;
+       bits = 0;
+       numBits = 0;
+       lastByte = 0;
+     }
+ 
+     /**
+      * Gets the next bits without consuming them.
+      *
+      * @param n number of bits, in the range [0, 31]
+      * @return the bits, the first one being the least significant
+      * @throws Exception when some problem manipulating the stream occurs
+      */
+     int peek(int n) throws Exception{
+       if(numBits < n){
+         fill();
+       }
+       return((int) bits & ((1 << n) - 1));
+     }
+ 
+     /**
+      * Consumes bits previously obtained with <code>peek</code>.
+      *
+      * @param n number of bits
+      */
+     void skip(int n){
+       bits >>>= n;
+       numBits -= n;
+     }
+ 
+     /**
+      * Gets and consumes the next bits.
+      *
+      * @param n number of bits, in the range [0, 31]
+      * @return the bits, the first one being the least significant
+      * @throws Exception when some problem manipulating the stream occurs
+      */
+     int getBits(int n) throws Exception{
+       int value = peek(n);
+       skip(n);
+       return(value);
+     }
+ 
+     /**
+      * Reads bytes until more than 56 bits are available.
+      *
+      * @throws Exception when some problem manipulating the stream occurs
+      */
+     private void fill() throws Exception{
+       while(numBits <= 56){
+         int b = 0;
+         if(position != limit){
+           b = stream.getByte(position) & 0xFF;
+           position += step;
+         }
+         bits |= (long) b << numBits;
+         numBits += lastByte > stuffThreshold ? 7: 8;
+         lastByte = b;
+       }
+     }
+   }
+ }
\ No newline at end of file
@@ -0,0 +1,276 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ 
+ /**
+  * This class maps 64-bit context keys to a fixed number of context slots. It is employed by the
+  * <code>ArithmeticCoder</code> when the context space is too large or too sparse to be indexed
+  * directly, so that the memory employed by the coder does not depend on the size of the model.<br>
+  *
+  * The table is an open-addressing hash table divided in buckets of <code>BUCKET_SLOTS</code> slots.
+  * The tag and the stamp of the slots of a bucket are stored contiguously in 64 bytes, so that a
+  * lookup touches a single cache line. Within a bucket, the key is identified through a checksum
+  * of the hash. When the bucket is full, the slot to be replaced is selected by the replacement
+  * policy. When no checksum is employed, each key is mapped to a single slot and collisions are
+  * not detected (the colliding keys share the same context).<br>
+  *
+  * The table is emptied in constant time: the slots whose stamp is older than the last
+  * <code>clear</code> are considered empty, so that the cost of a reset of the coder does not
+  * depend on the size of the table. The clock is kept below 2^30 by rebasing the stamps, so that
+  * long messages do not make the stamps wrap around.<br>
+  *
+  * Multithreading support: the object must be created and manipulated by a single thread.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class HashedContextTable{
+ 
+   /**
+    * Replacement policy that replaces the slot least recently employed.
+    */
+   public static final int REPLACEMENT_LRU = 0;
+ 
+   /**
+    * Replacement policy that replaces the slot inserted first.
+    */
+   public static final int REPLACEMENT_FIFO = 1;
+ 
+   /**
+    * Number of slots of each bucket.
+    * <p>
+    * Each slot employs two integers, so a bucket takes 64 bytes.
+    */
+   private static final int BUCKET_SLOTS = 8;
+ 
+   /**
+    * Tag and stamp of each slot.
+    * <p>
+    * Position 2 * slot holds the tag and position 2 * slot + 1 the stamp employed by the
+    * replacement policy. The slot is empty when its stamp is not greater than the epoch.
+    */
+   private int[] slots = null;
+ 
+   /**
+    * Number of slots of the table.
+    * <p>
+    * It is a power of 2 greater or equal than <code>BUCKET_SLOTS</code>.
+    */
+   private int numSlots;
+ 
+   /**
+    * Mask applied to the hash to obtain the bucket.
+    * <p>
+    * Equal to the number of buckets minus 1.
+    */
+   private int bucketMask;
+ 
+   /**
+    * Number of bits of the checksum stored in the tag.
+    * <p>
+    * In the range [0, 31]. 0 indicates that collisions are not detected.
+    */
+   private int checksumBits;
+ 
+   /**
+    * Replacement policy.
+    * <p>
+    * Either <code>REPLACEMENT_LRU</code> or <code>REPLACEMENT_FIFO</code>.
+    */
+   private int replacementPolicy;
+ 
+   /**
+    * Counter of lookups employed to stamp the slots.
+    * <p>
+    * In the range [0, 2^30]; the stamps are rebased by <code>find</code> when it reaches 2^30, so
+    * that their differences never overflow.
+    */
+   private int clock = 0;
+ 
+   /**
+    * Value of the clock at the last <code>clear</code>.
+    * <p>
+    * Slots with a stamp lower or equal than the epoch are empty.
+    */
+   private int epoch = 0;
+ 
+ 
+   /**
+    * Creates a table with the number of slots specified.
+    *
+    * @param logNumSlots base-2 logarithm of the number of slots, in the range [3, 30]
+    * @param checksumBits number of bits of the checksum employed to detect collisions, in the
+    * range [0, 31]. 0 maps each key to a single slot without detecting collisions
+    * @param replacementPolicy either <code>REPLACEMENT_LRU</code> or <code>REPLACEMENT_FIFO</code>
+    */
+   public HashedContextTable(int logNumSlots, int checksumBits, int replacementPolicy){
+     this.numSlots = 1 << logNumSlots;
+     this.bucketMask = (numSlots / BUCKET_SLOTS) - 1;
+     this.checksumBits = checksumBits;
+     this.replacementPolicy = replacementPolicy;
+     slots = new int[numSlots * 2];
+   }
+ 
+   /**
+    * Finds the slot assigned to a key. If the key is not in the table, a slot of its bucket is
+    * assigned to it, replacing another key when the bucket is full.
+    *
+    * @param key context key
+    * @return the slot assigned to the key when the key was already in the table, or the one's
+    * complement of the slot (a negative value) when the slot has been newly assigned and its
+    * context has to be initialized
+    */
+   public int find(long key){
+     long hash = hash(key);
+     int bucket = ((int) hash) & bucketMask;
+     if(checksumBits == 0){
+       return(bucket * BUCKET_SLOTS + ((int) (hash >>> 61)));
+     }
+ 
+     int first = bucket * BUCKET_SLOTS * 2;
+     int tag = tag(hash);
+     clock++;
+     if((clock >>> 30) != 0){
+       rebase();
+     }
+     int position = probe(first, tag);
+     if(position >= 0){
+       if(replacementPolicy == REPLACEMENT_LRU){
+         slots[position + 1] = clock;
+       }
+       return(position >> 1);
+     }
+ 
+     int victim = ~position;
+     if(victim == first + BUCKET_SLOTS * 2){ //Full bucket
+       victim = first;
+       int victimAge = 0;
+       for(int i = first; i < first + BUCKET_SLOTS * 2; i += 2){
+         int age = clock - slots[i + 1];
+         if(age > victimAge){
+           victimAge = age;
+           victim = i;
+         }
+       }
+     }
+     slots[victim] = tag;
+     slots[victim + 1] = clock;
+     return(~(victim >> 1));
+   }
+ 
+   /**
+    * Loads the bucket of a key so that it is in the cache for a subsequent <code>find</code>,
+    * and gets the slot that the key is likely to employ, so that the caller can also load its
+    * context. The table is not modified.
+    *
+    * @param key context key
+    * @return the slot assigned to the key when the key is in the table, or the first slot of its
+    * bucket otherwise
+    */
+   public int prefetch(long key){
+     long hash = hash(key);
+     int bucket = ((int) hash) & bucketMask;
+     if(checksumBits == 0){
+       return(bucket * BUCKET_SLOTS + ((int) (hash >>> 61)));
+     }
+ 
+     int first = bucket * BUCKET_SLOTS * 2;
+     int position = probe(first, tag(hash));
+     return((position >= 0 ? position: first) >> 1);
+   }
+ 
+   /**
+    * Searches a tag in a bucket. Slots are filled in order, so the search ends at the first
+    * empty slot.
+    *
+    * @param first position of the first slot of the bucket in <code>slots</code>
+    * @param tag tag searched
+    * @return position of the slot with the tag in <code>slots</code>, or the one's complement of
+    * the position of the first empty slot when the tag is not found (first + 2 * BUCKET_SLOTS when
+    * the bucket is full)
+    */
+   private int probe(int first, int tag){
+     int i = first;
+     for(; i < first + BUCKET_SLOTS * 2; i += 2){
+       if(slots[i + 1] - epoch <= 0){
+         break;
+       }
+       if(slots[i] == tag){
+         return(i);
+       }
+     }
+     return(~i);
+   }
+ 
+   /**
+    * Computes the tag of a key, its checksum with a bit set so that it is never 0.
+    *
+    * @param hash hash of the key
+    * @return tag of the key
+    */
+   private int tag(long hash){
+     return(((int) (hash >>> (64 - checksumBits))) | (1 << checksumBits));
+   }
+ 
+   /**
+    * Empties the table in constant time.
+    */
+   public void clear(){
+     epoch = clock;
+   }
+ 
+   /**
+    * Gets the number of slots of the table, which is the number of contexts that the coder
+    * has to allocate.
+    *
+    * @return number of slots
+    */
+   public int getNumSlots(){
+     return(numSlots);
+   }
+ 
+   /**
+    * Moves the clock back from 2^30 to 2^29, and the stamps and the epoch with it, keeping the
+    * keys of the table. Empty slots are erased, and stamps older than 2^29 lookups become 1, so
+    * the order of the recent stamps is kept. The cost is amortized over 2^29 lookups.
+    */
+   private void rebase(){
+     int shift = clock - (1 << 29);
+     for(int i = 0; i < slots.length; i += 2){
+       int stamp = slots[i + 1];
+       if(stamp - epoch <= 0){
+         slots[i] = 0;
+         slots[i + 1] = 0;
+       }else{
+         stamp -= shift;
+         slots[i + 1] = stamp < 1 ? 1: stamp;
+       }
+     }
+     epoch = epoch - shift < 0 ? 0: epoch - shift;
+     clock -= shift;
+   }
+ 
+   /**
+    * Mixes the bits of the key so that both the low and the high bits of the result depend on
+    * all the bits of the key (finalizer of MurmurHash3).
+    *
+    * @param key context key
+    * @return hash of the key
+    */
+   private static long hash(long key){
+     key ^= key >>> 33;
+     key *= 0xFF51AFD7ED558CCDL;
+     key ^= key >>> 33;
+     key *= 0xC4CEB9FE1A85EC53L;
+     key ^= key >>> 33;
+     return(key);
+   }
+ }
\ No newline at end of file
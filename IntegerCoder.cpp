@@ -0,0 +1,167 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ 
+ /**
+  * This class implements the arithmetic integer coding procedure of the JBIG2 standard (IAx,
+  * ITU-T T.88, annex A.2). An integer is coded as a sign bit, a unary prefix that selects one of
+  * six ranges and the offset within the range in 2, 4, 6, 8, 12 or 32 bits, so small integers
+  * take few symbols: integers in [-3, 3] are coded with 4 symbols. Each symbol is coded with the
+  * <code>ArithmeticCoder</code> in a context given by the previous symbols of the integer (up to
+  * 9 bits, 512 contexts). The out-of-band value (OOB) is coded as -0.<br>
+  *
+  * The contexts belong to a bank of <code>NUM_CONTEXTS</code> contexts of the
+  * <code>ArithmeticCoder</code> starting at a given offset, so that the different integer
+  * procedures of a region (and the <code>GenericRegionCoder</code>, or the
+  * <code>SymbolIDCoder</code>) can share the same coder, each one with its own bank.<br>
+  *
+  * Multithreading support: the object holds no state other than its bank, so it can be employed
+  * by many threads as long as each thread employs its own <code>ArithmeticCoder</code>.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class IntegerCoder{
+ 
+   /**
+    * Number of contexts of the bank of an integer procedure.
+    */
+   public static final int NUM_CONTEXTS = 512;
+ 
+   /**
+    * Out-of-band value.
+    * <p>
+    * Integers equal to this value cannot be coded.
+    */
+   public static final int OOB = Integer.MIN_VALUE;
+ 
+   /**
+    * Number of bits of the offset within each range.
+    * <p>
+    * Indexed by the number of 1s of the prefix.
+    */
+   private static final int[] RANGE_BITS = {2, 4, 6, 8, 12, 32};
+ 
+   /**
+    * First magnitude of each range.
+    * <p>
+    * Indexed by the number of 1s of the prefix.
+    */
+   private static final int[] RANGE_OFFSETS = {0, 4, 20, 84, 340, 4436};
+ 
+   /**
+    * Last range (the prefix has no terminating 0).
+    * <p>
+    * Equal to RANGE_BITS.length - 1.
+    */
+   private static final int LAST_RANGE = 5;
+ 
+   /**
+    * First context of the bank in the <code>ArithmeticCoder</code>.
+    * <p>
+    * The bank spans <code>NUM_CONTEXTS</code> contexts.
+    */
+   private int contextOffset;
+ 
+ 
+   /**
+    * Creates the procedure.
+    *
+    * @param contextOffset first context of the bank in the <code>ArithmeticCoder</code>
+    */
+   public IntegerCoder(int contextOffset){
+     this.contextOffset = contextOffset;
+   }
+ 
+   /**
+    * Encodes an integer.
+    *
+    * @param coder coder employed, already restarted for encoding
+    * @param value integer to encode, or <code>OOB</code>
+    */
+   public void encode(BinaryCoder coder, int value){
+     int magnitude = value < 0 ? -value: value;
+     int range = 0;
+     if(value != OOB){
+       while((range < LAST_RANGE) && (magnitude >= RANGE_OFFSETS[range + 1])){
+         range++;
+       }
+       magnitude -= RANGE_OFFSETS[range];
+     }else{
+       magnitude = 0;
+     }
+ 
+     int prev = encodeBit(coder, 1, value < 0);
+     for(int r = 0; r < range; r++){
+       prev = encodeBit(coder, prev, true);
+     }
+     if(range < LAST_RANGE){
+       prev = encodeBit(coder, prev, false);
+     }
+     for(int b = RANGE_BITS[range] - 1; b >= 0; b--){
+       prev = encodeBit(coder, prev, ((magnitude >>> b) & 1) != 0);
+     }
+   }
+ 
+   /**
+    * Decodes an integer.
+    *
+    * @param coder coder employed, already restarted for decoding
+    * @return the integer decoded, or <code>OOB</code>
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public int decode(BinaryCoder coder) throws Exception{
+     boolean negative = coder.decodeBitContext(contextOffset + 1);
+     int prev = negative ? 3: 2;
+     int range = 0;
+     while(range < LAST_RANGE){
+       boolean bit = coder.decodeBitContext(contextOffset + prev);
+       prev = (prev << 1) | (bit ? 1: 0);
+       if(!bit){
+         break;
+       }
+       range++;
+     }
+ 
+     int magnitude = 0;
+     for(int b = RANGE_BITS[range]; b > 0; b--){
+       int bit = coder.decodeBitContext(contextOffset + prev) ? 1: 0;
+       magnitude = (magnitude << 1) | bit;
+       prev = (prev << 1) | bit;
+       if(prev >= NUM_CONTEXTS){
+         prev = (prev & (NUM_CONTEXTS - 1)) | (NUM_CONTEXTS >> 1);
+       }
+     }
+     magnitude += RANGE_OFFSETS[range];
+ 
+     if(negative){
+       return(magnitude == 0 ? OOB: -magnitude);
+     }
+     return(magnitude);
+   }
+ 
+   /**
+    * Encodes a symbol and updates the previous symbols.
+    *
+    * @param coder coder employed
+    * @param prev previous symbols (the context within the bank)
+    * @param bit symbol to encode
+    * @return the previous symbols after the symbol
+    */
+   private int encodeBit(BinaryCoder coder, int prev, boolean bit){
+     coder.encodeBitContext(bit, contextOffset + prev);
+     prev = (prev << 1) | (bit ? 1: 0);
+     if(prev >= NUM_CONTEXTS){
+       prev = (prev & (NUM_CONTEXTS - 1)) | (NUM_CONTEXTS >> 1);
+     }
+     return(prev);
+   }
+ }
\ No newline at end of file
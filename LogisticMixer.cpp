@@ -0,0 +1,307 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ 
+ /**
+  * This class implements a logistic mixer (context mixing) that combines the predictions of
+  * several models into a single probability for <code>encodeBitProb</code> and
+  * <code>decodeBitProb</code>. The probabilities of the models are transformed to the logistic
+  * (stretch) domain, ln(p / (1 - p)), added with a vector of weights and transformed back with the
+  * squash function, 1 / (1 + e^-x). After coding each bit, the weights are trained online by
+  * gradient descent on the coding cost. Several weight vectors can be kept, selected by a context
+  * before mixing. The number of inputs and of weight vectors select the trade-off between speed and
+  * compression.<br>
+  *
+  * Probabilities are of the symbol 0, in 12 bits, and the stretch domain is in the range
+  * [-2047, 2047] (8 fractional bits). The weights have 16 fractional bits. All the arithmetic
+  * is integer; the tables of stretch and squash are computed once.<br>
+  *
+  * Usage: for each bit, the predictions are added with <code>add</code> (or
+  * <code>addStretched</code>), the weight vector is selected with <code>setContext</code> and the
+  * bit is coded with <code>encodeBit</code> or <code>decodeBit</code>, which train the weights.
+  * To refine the probability with an <code>AdaptiveProbabilityMap</code>, the bit is coded with
+  * <code>mix</code>, the map, <code>ArithmeticCoder.prob12ToMQ</code> and the
+  * <code>encodeBitProb</code> of the coder, and then <code>update</code> is called.<br>
+  *
+  * Multithreading support: the object must be created and manipulated by a single thread. There
+  * can be many objects of this class running simultaneously as long as a single thread manipulates
+  * each object.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class LogisticMixer{
+ 
+   /**
+    * Number of bits of the probabilities.
+    * <p>
+    * Probabilities are in the range [1, 2^PROB_BITS - 1].
+    */
+   public static final int PROB_BITS = 12;
+ 
+   /**
+    * Largest absolute value of the stretch domain.
+    * <p>
+    * The stretch domain has 8 fractional bits.
+    */
+   public static final int MAX_STRETCH = 2047;
+ 
+   /**
+    * Default learning rate.
+    * <p>
+    * Multiplies the error of the prediction when training.
+    */
+   public static final int DEFAULT_LEARNING_RATE = 6;
+ 
+   /**
+    * Squash function, indexed by x + 2048 for x in the stretch domain.
+    * <p>
+    * 2^PROB_BITS / (1 + e^(-x / 256)), clamped to [1, 2^PROB_BITS - 1].
+    */
+   private static final int[] SQUASH_TABLE = new int[4096];
+ 
+   /**
+    * Stretch function (inverse of squash), indexed by the probability.
+    * <p>
+    * In the range [-2047, 2047].
+    */
+   private static final int[] STRETCH_TABLE = new int[4096];
+ 
+   static{
+     for(int x = -2048; x < 2048; x++){
+       int p = (int) Math.round(4096d / (1d + Math.exp(-x / 256d)));
+       SQUASH_TABLE[x + 2048] = p < 1 ? 1: (p > 4095 ? 4095: p);
+     }
+     //The inverse is taken as the lowest x whose squash reaches the probability
+     int p = 0;
+     for(int x = -MAX_STRETCH; x <= MAX_STRETCH; x++){
+       int v = squash(x);
+       for(; p <= v; p++){
+         STRETCH_TABLE[p] = x;
+       }
+     }
+     for(; p < 4096; p++){
+       STRETCH_TABLE[p] = MAX_STRETCH;
+     }
+   }
+ 
+   /**
+    * Number of inputs.
+    * <p>
+    * Rounded up to a multiple of 4; unused inputs are 0.
+    */
+   private int numInputs;
+ 
+   /**
+    * Number of weight vectors.
+    * <p>
+    * Set when the class is instantiated.
+    */
+   private int numWeightSets;
+ 
+   /**
+    * Learning rate.
+    * <p>
+    * Set when the class is instantiated.
+    */
+   private int learningRate;
+ 
+   /**
+    * Weights of all the vectors, one after the other.
+    * <p>
+    * 16 fractional bits.
+    */
+   private int[] weights;
+ 
+   /**
+    * Inputs of the current bit, in the stretch domain.
+    * <p>
+    * The first <code>numAdded</code> are valid.
+    */
+   private int[] inputs;
+ 
+   /**
+    * Number of inputs added for the current bit.
+    * <p>
+    * At most <code>numInputs</code>.
+    */
+   private int numAdded;
+ 
+   /**
+    * Offset of the selected weight vector in <code>weights</code>.
+    * <p>
+    * Set with <code>setContext</code>.
+    */
+   private int weightOffset;
+ 
+   /**
+    * Probability of the last mix.
+    * <p>
+    * In PROB_BITS bits.
+    */
+   private int prob;
+ 
+ 
+   /**
+    * Creates the mixer with the default learning rate.
+    *
+    * @param numInputs maximum number of predictions mixed
+    * @param numWeightSets number of weight vectors, selected with <code>setContext</code>
+    */
+   public LogisticMixer(int numInputs, int numWeightSets){
+     this(numInputs, numWeightSets, DEFAULT_LEARNING_RATE);
+   }
+ 
+   /**
+    * Creates the mixer.
+    *
+    * @param numInputs maximum number of predictions mixed
+    * @param numWeightSets number of weight vectors, selected with <code>setContext</code>
+    * @param learningRate learning rate, in the range [1, 32]; higher rates adapt faster
+    */
+   public LogisticMixer(int numInputs, int numWeightSets, int learningRate){
+     this.numInputs = (numInputs + 3) & ~3;
+     this.numWeightSets = numWeightSets;
+     this.learningRate = learningRate;
+     weights = new int[this.numInputs * numWeightSets];
+     inputs = new int[this.numInputs];
+     reset();
+   }
+ 
+   /**
+    * Sets all weights to 1 / numInputs (rounded up to a multiple of 4), so that the initial
+    * prediction is about the mean of the inputs in the stretch domain.
+    */
+   public void reset(){
+     int initialWeight = (1 << 16) / numInputs;
+     for(int w = 0; w < weights.length; w++){
+       weights[w] = initialWeight;
+     }
+     for(int i = 0; i < numInputs; i++){
+       inputs[i] = 0;
+     }
+     numAdded = 0;
+     weightOffset = 0;
+     prob = 1 << (PROB_BITS - 1);
+   }
+ 
+   /**
+    * Adds the prediction of a model for the current bit.
+    *
+    * @param prob0 probability of the symbol 0 in PROB_BITS bits
+    */
+   public void add(int prob0){
+     inputs[numAdded++] = STRETCH_TABLE[prob0];
+   }
+ 
+   /**
+    * Adds the prediction of a model for the current bit, already in the stretch domain.
+    *
+    * @param stretchedProb0 stretched probability of the symbol 0, in the range [-2047, 2047]
+    */
+   public void addStretched(int stretchedProb0){
+     inputs[numAdded++] = stretchedProb0;
+   }
+ 
+   /**
+    * Selects the weight vector employed for the current bit.
+    *
+    * @param context index of the weight vector, in the range [0, numWeightSets - 1]
+    */
+   public void setContext(int context){
+     weightOffset = context * numInputs;
+   }
+ 
+   /**
+    * Mixes the predictions added for the current bit.
+    *
+    * @return probability of the symbol 0 in PROB_BITS bits
+    */
+   public int mix(){
+     //Unrolled by 4 with independent sums so the loop can be vectorized
+     long sum0 = 0;
+     long sum1 = 0;
+     long sum2 = 0;
+     long sum3 = 0;
+     for(int i = 0, w = weightOffset; i < numInputs; i += 4, w += 4){
+       sum0 += (long) inputs[i] * weights[w];
+       sum1 += (long) inputs[i + 1] * weights[w + 1];
+       sum2 += (long) inputs[i + 2] * weights[w + 2];
+       sum3 += (long) inputs[i + 3] * weights[w + 3];
+     }
+     long dot = (sum0 + sum1 + sum2 + sum3) >> 16;
+     prob = squash(dot < -MAX_STRETCH ? -MAX_STRETCH: (dot > MAX_STRETCH ? MAX_STRETCH: (int) dot));
+     return(prob);
+   }
+ 
+   /**
+    * Trains the selected weight vector with the bit coded and clears the inputs for the next bit.
+    *
+    * @param bit bit coded
+    */
+   public void update(boolean bit){
+     int error = ((bit ? 0: 1 << PROB_BITS) - prob) * learningRate;
+     for(int i = 0, w = weightOffset; i < numInputs; i += 4, w += 4){
+       weights[w] += (inputs[i] * error) >> 14;
+       weights[w + 1] += (inputs[i + 1] * error) >> 14;
+       weights[w + 2] += (inputs[i + 2] * error) >> 14;
+       weights[w + 3] += (inputs[i + 3] * error) >> 14;
+     }
+     for(int i = 0; i < numAdded; i++){
+       inputs[i] = 0;
+     }
+     numAdded = 0;
+   }
+ 
+   /**
+    * Encodes a bit with the mixed probability and trains the weights.
+    *
+    * @param coder coder employed
+    * @param bit input
+    */
+   public void encodeBit(BinaryCoder coder, boolean bit){
+     coder.encodeBitProb(bit, ArithmeticCoder.prob12ToMQ(mix()));
+     update(bit);
+   }
+ 
+   /**
+    * Decodes a bit with the mixed probability and trains the weights.
+    *
+    * @param coder coder employed
+    * @return output bit
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public boolean decodeBit(BinaryCoder coder) throws Exception{
+     boolean bit = coder.decodeBitProb(ArithmeticCoder.prob12ToMQ(mix()));
+     update(bit);
+     return(bit);
+   }
+ 
+   /**
+    * Computes the squash function.
+    *
+    * @param x value in the stretch domain, in the range [-2047, 2047]
+    * @return probability in PROB_BITS bits
+    */
+   public static int squash(int x){
+     return(SQUASH_TABLE[x + 2048]);
+   }
+ 
+   /**
+    * Computes the stretch function.
+    *
+    * @param prob probability in PROB_BITS bits
+    * @return value in the stretch domain, in the range [-2047, 2047]
+    */
+   public static int stretch(int prob){
+     return(STRETCH_TABLE[prob]);
+   }
+ }
\ No newline at end of file
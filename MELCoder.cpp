@@ -0,0 +1,335 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ import streams.ByteStream;
+ 
+ 
+ /**
+  * This class implements the adaptive run-length coder MEL employed in HTJ2K. It codes binary
+  * events that are mostly 0 as runs of 0s: a run of 2^e 0s is coded with the bit 1, and a shorter
+  * run followed by a 1 with the bit 0 and the length of the run in e bits. The exponent e is given
+  * by a state that increases after each complete run and decreases after each 1, so the coder
+  * adapts to the probability of the events.<br>
+  *
+  * Bits are packed from the most significant bit of each byte. After a 0xFF byte, the most
+  * significant bit of the next byte is a stuffed 0, as in the <code>ArithmeticCoder</code>, so that
+  * no marker appears in the stream.<br>
+  *
+  * Usage: once the object is created, the functions to code events can be called. When encoding,
+  * the stream must be terminated calling <code>terminate</code>.<br>
+  *
+  * Multithreading support: the object must be created and manipulated by a single thread. There
+  * can be many objects of this class running simultaneously as long as a single thread manipulates
+  * each object.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class MELCoder{
+ 
+   /**
+    * Exponent of the run length of each state.
+    * <p>
+    * The complete run of a state of exponent e has 2^e events 0.
+    */
+   private static final int[] MEL_EXPONENTS = {0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 4, 5};
+ 
+   /**
+    * Last state.
+    * <p>
+    * Equal to MEL_EXPONENTS.length - 1.
+    */
+   private static final int MAX_STATE = 12;
+ 
+   /**
+    * ByteStream employed to write or read the bits.
+    * <p>
+    * Set with <code>changeStream</code>.
+    */
+   private ByteStream stream = null;
+ 
+   /**
+    * Current state.
+    * <p>
+    * In the range [0, MAX_STATE].
+    */
+   private int state;
+ 
+   /**
+    * Events 0 of the current run.
+    * <p>
+    * When encoding, the events coded; when decoding, the events pending.
+    */
+   private int run;
+ 
+   /**
+    * Indicates that an event 1 follows the current run (for decoding purposes).
+    * <p>
+    * False when the run is complete.
+    */
+   private boolean pendingOne;
+ 
+   /**
+    * Byte being written or read.
+    * <p>
+    * When encoding, the bits written so far; when decoding, the byte read.
+    */
+   private int currentByte;
+ 
+   /**
+    * Bits of <code>currentByte</code> not written or read yet.
+    * <p>
+    * 7 after a 0xFF byte, 8 otherwise.
+    */
+   private int numBits;
+ 
+   /**
+    * Last complete byte written or read.
+    * <p>
+    * Determines whether the next byte carries a stuffed bit.
+    */
+   private int lastByte;
+ 
+   /**
+    * Position of the next byte read (for decoding purposes).
+    * <p>
+    * Bytes from <code>end</code> onwards are read as 0xFF.
+    */
+   private int position;
+ 
+   /**
+    * End of the segment read (for decoding purposes).
+    * <p>
+    * Exclusive.
+    */
+   private int end;
+ 
+ 
+   /**
+    * Creates the coder. Before coding, the stream must be set with <code>changeStream</code>
+    * and the coder restarted.
+    */
+   public MELCoder(){
+   }
+ 
+   /**
+    * Changes the current stream.
+    *
+    * @param stream the new ByteStream
+    */
+   public void changeStream(ByteStream stream){
+     this.stream = stream;
+   }
+ 
+   /**
+    * Restarts the state and the registers of the coder for encoding. Bytes are appended to the
+    * stream.
+    */
+   public void restartEncoding(){
+     state = 0;
+     run = 0;
+     currentByte = 0;
+     numBits = 8;
+     lastByte = 0;
+   }
+ 
+   /**
+    * Restarts the state and the registers of the coder for decoding the whole stream.
+    */
+   public void restartDecoding(){
+     restartDecoding(0, (int) stream.getLength());
+   }
+ 
+   /**
+    * Restarts the state and the registers of the coder for decoding a segment of the stream.
+    *
+    * @param begin first byte of the segment (inclusive)
+    * @param end last byte of the segment (exclusive)
+    */
+   public void restartDecoding(int begin, int end){
+     state = 0;
+     run = 0;
+     pendingOne = false;
+     currentByte = 0;
+     numBits = 0;
+     lastByte = 0;
+     position = begin;
+     this.end = end;
+   }
+ 
+   /**
+    * Encodes an event.
+    *
+    * @param one true for an event 1, false for an event 0
+    */
+   public void encodeBit(boolean one){
+     int exponent = MEL_EXPONENTS[state];
+     if(!one){
+       run++;
+       if(run == 1 << exponent){
+         putBit(1);
+         run = 0;
+         state = state < MAX_STATE ? state + 1: MAX_STATE;
+       }
+     }else{
+       putBit(0);
+       for(int b = exponent - 1; b >= 0; b--){
+         putBit((run >> b) & 1);
+       }
+       run = 0;
+       state = state > 0 ? state - 1: 0;
+     }
+   }
+ 
+   /**
+    * Encodes a run of events 0 followed by an event 1. The complete runs of the states are coded
+    * with a single bit each, so the cost does not depend on the number of events.
+    *
+    * @param zeros number of events 0
+    */
+   public void encodeRun(int zeros){
+     zeros += run;
+     run = 0;
+     while(zeros >= 1 << MEL_EXPONENTS[state]){
+       zeros -= 1 << MEL_EXPONENTS[state];
+       putBit(1);
+       state = state < MAX_STATE ? state + 1: MAX_STATE;
+     }
+     run = zeros;
+     encodeBit(true);
+   }
+ 
+   /**
+    * Decodes an event.
+    *
+    * @return true for an event 1, false for an event 0
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public boolean decodeBit() throws Exception{
+     if((run == 0) && !pendingOne){
+       decodeRunLength();
+     }
+     if(run > 0){
+       run--;
+       return(false);
+     }
+     pendingOne = false;
+     return(true);
+   }
+ 
+   /**
+    * Decodes a run of events 0 and the event 1 that follows it, up to a maximum number of events 0.
+    *
+    * @param maxZeros maximum number of events 0 decoded
+    * @return the number of events 0 decoded. When it is <code>maxZeros</code>, the event 1 (if any)
+    * is not decoded
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public int decodeRun(int maxZeros) throws Exception{
+     int zeros = 0;
+     while(zeros < maxZeros){
+       if((run == 0) && !pendingOne){
+         decodeRunLength();
+       }
+       if(run == 0){
+         pendingOne = false;
+         return(zeros);
+       }
+       int take = run < maxZeros - zeros ? run: maxZeros - zeros;
+       run -= take;
+       zeros += take;
+     }
+     return(zeros);
+   }
+ 
+   /**
+    * Terminates the current stream (for encoding purposes). The run in progress is coded as
+    * complete and the last byte is padded with 0s. When the last byte is 0xFF, a byte 0 is added,
+    * so that it cannot form a marker with the bytes that follow.
+    */
+   public void terminate(){
+     if(run > 0){
+       putBit(1);
+       run = 0;
+     }
+     if(numBits < (lastByte == 0xFF ? 7: 8)){
+       currentByte <<= numBits;
+       numBits = 0;
+       putByte();
+     }
+     if(lastByte == 0xFF){
+       putByte();
+     }
+   }
+ 
+   /**
+    * Reads the codeword of the next run (for decoding purposes).
+    *
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   private void decodeRunLength() throws Exception{
+     int exponent = MEL_EXPONENTS[state];
+     if(getBit() != 0){
+       run = 1 << exponent;
+       state = state < MAX_STATE ? state + 1: MAX_STATE;
+     }else{
+       for(int b = 0; b < exponent; b++){
+         run = (run << 1) | getBit();
+       }
+       pendingOne = true;
+       state = state > 0 ? state - 1: 0;
+     }
+   }
+ 
+   /**
+    * Writes a bit to the stream (for encoding purposes).
+    *
+    * @param bit 0 or 1
+    */
+   private void putBit(int bit){
+     currentByte = (currentByte << 1) | bit;
+     numBits--;
+     if(numBits == 0){
+       putByte();
+     }
+   }
+ 
+   /**
+    * Writes <code>currentByte</code> to the stream and starts the next byte (for encoding purposes).
+    */
+   private void putByte(){
+     stream.putByte((byte) currentByte);
+     lastByte = currentByte;
+     currentByte = 0;
+     numBits = lastByte == 0xFF ? 7: 8;
+   }
+ 
+   /**
+    * Reads a bit from the stream, or 1 when the end of the segment is reached (for decoding
+    * purposes).
+    *
+    * @return 0 or 1
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   private int getBit() throws Exception{
+     if(numBits == 0){
+       numBits = lastByte == 0xFF ? 7: 8;
+       currentByte = 0xFF;
+       if(position < end){
+         currentByte = stream.getByte(position) & 0xFF;
+         position++;
+       }
+       lastByte = currentByte;
+     }
+     numBits--;
+     return((currentByte >> numBits) & 1);
+   }
+ }
\ No newline at end of file
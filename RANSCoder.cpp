@@ -0,0 +1,455 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ import java.util.Arrays;
+ import streams.ByteStream;
+ 
+ 
+ /**
+  * This class implements a binary range asymmetric numeral system (rANS) coder with the same
+  * contexts as the <code>ArithmeticCoder</code>: each context follows the 47-state machine of the
+  * MQ coder (<code>STATE_TRANSITIONS_MPS</code>, <code>STATE_TRANSITIONS_LPS</code> and
+  * <code>STATE_CHANGE</code>), and the probability of each state is <code>STATE_PROB</code>
+  * scaled to 15 bits. The MQ coder updates the state after a most probable symbol only when its
+  * interval register A is renormalized, so a copy of this register is kept to update the states
+  * exactly as the MQ coder does. The copy is also updated by the bits coded with
+  * <code>encodeBitProb</code> and <code>decodeBitProb</code>, as in the MQ coder.<br>
+  *
+  * rANS decodes in the reverse order in which it encodes, so the encoder keeps the symbols and
+  * their probabilities in a buffer and encodes them backwards when the stream is terminated; the
+  * bytes are then written so that the decoder reads them forward. Two rANS states are
+  * interleaved (even and odd symbols), so the dependency chain of the decoder is split in two.
+  * Decoding is fast and branch-light: a symbol takes a mask, a comparison, a multiplication and,
+  * from time to time, a byte read.<br>
+  *
+  * Usage: as the <code>ArithmeticCoder</code>. Nothing is written to the stream until
+  * <code>terminate</code> is called.<br>
+  *
+  * Multithreading support: the object must be created and manipulated by a single thread. There
+  * can be many objects of this class running simultaneously as long as a single thread manipulates
+  * each object.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class RANSCoder implements BinaryCoder{
+ 
+   /**
+    * Number of bits of the probabilities.
+    * <p>
+    * The frequencies of the two symbols add up to 2^PROB_BITS.
+    */
+   private static final int PROB_BITS = 15;
+ 
+   /**
+    * Sum of the frequencies of the two symbols.
+    * <p>
+    * Equal to 2^PROB_BITS.
+    */
+   private static final int PROB_SCALE = 1 << PROB_BITS;
+ 
+   /**
+    * Lower bound of the rANS states.
+    * <p>
+    * States are kept in [RANS_L, 2^8 * RANS_L), so they fit in 31 bits.
+    */
+   private static final int RANS_L = 1 << 23;
+ 
+   /**
+    * Frequency of the least probable symbol of each state.
+    * <p>
+    * <code>STATE_PROB</code> converted with <code>ArithmeticCoder.MQToProbFixed</code>, at
+    * least 1.
+    */
+   private static final int[] LPS_FREQUENCIES = new int[ArithmeticCoder.STATE_PROB.length];
+ 
+   static{
+     for(int state = 0; state < LPS_FREQUENCIES.length; state++){
+       int frequency = ArithmeticCoder.MQToProbFixed(ArithmeticCoder.STATE_PROB[state], PROB_BITS);
+       LPS_FREQUENCIES[state] = frequency > 0 ? frequency: 1;
+     }
+   }
+ 
+   /**
+    * ByteStream employed to write or read the bytes.
+    * <p>
+    * Set with <code>changeStream</code>.
+    */
+   private ByteStream stream = null;
+ 
+   /**
+    * Number of contexts.
+    * <p>
+    * Set when the class is instantiated.
+    */
+   private int numContexts;
+ 
+   /**
+    * Current state of each context.
+    * <p>
+    * In the range [0, STATE_TRANSITIONS_MPS.length - 1].
+    */
+   private int[] contextState;
+ 
+   /**
+    * Most probable symbol of each context.
+    * <p>
+    * Either 0 or 1.
+    */
+   private int[] contextMPS;
+ 
+   /**
+    * Copy of the interval register A of the MQ coder.
+    * <p>
+    * Determines when the state of a context is updated after a most probable symbol.
+    */
+   private int A;
+ 
+   /**
+    * Symbols encoded since the last restart (for encoding purposes).
+    * <p>
+    * Each symbol is stored as (lps << 16) | lpsFrequency, lps being 1 when the least probable
+    * symbol was coded.
+    */
+   private int[] symbols = new int[1024];
+ 
+   /**
+    * Number of symbols in <code>symbols</code>.
+    * <p>
+    * Reset by <code>restartEncoding</code>.
+    */
+   private int numSymbols = 0;
+ 
+   /**
+    * Bytes produced by the encoder, in the reverse order in which they are read.
+    * <p>
+    * Only employed by <code>terminate</code>.
+    */
+   private byte[] reversedBytes = new byte[1024];
+ 
+   /**
+    * rANS state of the next symbol (for decoding purposes).
+    * <p>
+    * In the range [RANS_L, 2^8 * RANS_L).
+    */
+   private int x0;
+ 
+   /**
+    * rANS state of the symbol after the next one (for decoding purposes).
+    * <p>
+    * Swapped with <code>x0</code> after each symbol.
+    */
+   private int x1;
+ 
+   /**
+    * Position of the next byte read (for decoding purposes).
+    * <p>
+    * Bytes from <code>end</code> onwards are read as 0.
+    */
+   private int position;
+ 
+   /**
+    * End of the segment read (for decoding purposes).
+    * <p>
+    * Exclusive.
+    */
+   private int end;
+ 
+ 
+   /**
+    * Creates the coder. Before coding, the stream must be set with <code>changeStream</code>
+    * and the coder restarted.
+    *
+    * @param numContexts number of contexts
+    */
+   public RANSCoder(int numContexts){
+     this.numContexts = numContexts;
+     contextState = new int[numContexts];
+     contextMPS = new int[numContexts];
+     reset();
+     restartEncoding();
+   }
+ 
+   /**
+    * Changes the current stream.
+    *
+    * @param stream the new ByteStream
+    */
+   public void changeStream(ByteStream stream){
+     this.stream = stream;
+   }
+ 
+   /**
+    * Resets the state of all contexts.
+    */
+   public void reset(){
+     for(int c = 0; c < numContexts; c++){
+       contextState[c] = 0;
+       contextMPS[c] = 0;
+     }
+   }
+ 
+   /**
+    * Restarts the registers of the coder for encoding, discarding the symbols not terminated.
+    * Bytes are appended to the stream.
+    */
+   public void restartEncoding(){
+     numSymbols = 0;
+     A = 0x8000;
+   }
+ 
+   /**
+    * Restarts the registers of the coder for decoding the whole stream.
+    *
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void restartDecoding() throws Exception{
+     restartDecoding(0, (int) stream.getLength());
+   }
+ 
+   /**
+    * Restarts the registers of the coder for decoding a segment of the stream.
+    *
+    * @param begin first byte of the segment (inclusive)
+    * @param end last byte of the segment (exclusive)
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void restartDecoding(int begin, int end) throws Exception{
+     position = begin;
+     this.end = end;
+     x0 = 0;
+     x1 = 0;
+     for(int i = 0; i < 4; i++){
+       x0 = (x0 << 8) | getByte();
+     }
+     for(int i = 0; i < 4; i++){
+       x1 = (x1 << 8) | getByte();
+     }
+     A = 0x8000;
+   }
+ 
+   /**
+    * Encodes a bit using a context.
+    *
+    * @param bit input
+    * @param context context of the symbol
+    */
+   public void encodeBitContext(boolean bit, int context){
+     int state = contextState[context];
+     int lps = (bit ? 1: 0) ^ contextMPS[context];
+     putSymbol(lps, LPS_FREQUENCIES[state]);
+     update(context, state, lps);
+   }
+ 
+   /**
+    * Encodes a sequence of bits, each one with its own context.
+    *
+    * @param bits input bits, either 0 or 1
+    * @param contexts context of each bit
+    * @param length number of bits to encode
+    */
+   public void encodeBitsContext(int[] bits, int[] contexts, int length){
+     for(int i = 0; i < length; i++){
+       encodeBitContext(bits[i] != 0, contexts[i]);
+     }
+   }
+ 
+   /**
+    * Decodes a bit using a context.
+    *
+    * @param context context of the symbol
+    * @return output bit
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public boolean decodeBitContext(int context) throws Exception{
+     int state = contextState[context];
+     int mps = contextMPS[context];
+     int lps = decodeSymbol(LPS_FREQUENCIES[state]);
+     update(context, state, lps);
+     return((mps ^ lps) != 0);
+   }
+ 
+   /**
+    * Encodes a bit using a specified probability. The states of the contexts are not modified,
+    * but the copy of the interval register is.
+    *
+    * @param bit input
+    * @param prob0 probability of the symbol 0, as given by <code>ArithmeticCoder.prob0ToMQ</code>
+    */
+   public void encodeBitProb(boolean bit, int prob0){
+     int mps = prob0 >= 0 ? 0: 1;
+     int lps = (bit ? 1: 0) ^ mps;
+     putSymbol(lps, probToFrequency(prob0));
+     updateInterval(prob0 >= 0 ? prob0: -prob0, lps);
+   }
+ 
+   /**
+    * Decodes a bit using a specified probability.
+    *
+    * @param prob0 probability of the symbol 0, as given by <code>ArithmeticCoder.prob0ToMQ</code>
+    * @return output bit
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public boolean decodeBitProb(int prob0) throws Exception{
+     int mps = prob0 >= 0 ? 0: 1;
+     int lps = decodeSymbol(probToFrequency(prob0));
+     updateInterval(prob0 >= 0 ? prob0: -prob0, lps);
+     return((lps ^ mps) != 0);
+   }
+ 
+   /**
+    * Encodes the symbols buffered since the last restart, from the last one to the first one, and
+    * writes the bytes to the stream.
+    */
+   public void terminate(){
+     int numBytes = 0;
+     int[] x = {RANS_L, RANS_L};
+     for(int i = numSymbols - 1; i >= 0; i--){
+       int lpsFrequency = symbols[i] & 0xFFFF;
+       int lps = symbols[i] >>> 16;
+       int frequency = lps == 1 ? lpsFrequency: PROB_SCALE - lpsFrequency;
+       int start = lps == 1 ? PROB_SCALE - lpsFrequency: 0;
+ 
+       int xi = x[i & 1];
+       int xMax = ((RANS_L >> PROB_BITS) << 8) * frequency;
+       while(xi >= xMax){
+         if(numBytes == reversedBytes.length){
+           reversedBytes = Arrays.copyOf(reversedBytes, numBytes * 2);
+         }
+         reversedBytes[numBytes++] = (byte) xi;
+         xi >>>= 8;
+       }
+       x[i & 1] = ((xi / frequency) << PROB_BITS) + (xi % frequency) + start;
+     }
+ 
+     //The states are read first by the decoder, the one of the first symbol before
+     for(int s = 1; s >= 0; s--){
+       for(int i = 0; i < 4; i++){
+         if(numBytes == reversedBytes.length){
+           reversedBytes = Arrays.copyOf(reversedBytes, numBytes * 2);
+         }
+         reversedBytes[numBytes++] = (byte) (x[s] >>> (8 * i));
+       }
+     }
+     for(int i = numBytes - 1; i >= 0; i--){
+       stream.putByte(reversedBytes[i]);
+     }
+     numSymbols = 0;
+   }
+ 
+   /**
+    * Stores a symbol to encode (for encoding purposes).
+    *
+    * @param lps 1 for the least probable symbol, 0 otherwise
+    * @param lpsFrequency frequency of the least probable symbol
+    */
+   private void putSymbol(int lps, int lpsFrequency){
+     if(numSymbols == symbols.length){
+       symbols = Arrays.copyOf(symbols, numSymbols * 2);
+     }
+     symbols[numSymbols++] = (lps << 16) | lpsFrequency;
+   }
+ 
+   /**
+    * Decodes a symbol with the next rANS state and interleaves the states (for decoding
+    * purposes).
+    *
+    * @param lpsFrequency frequency of the least probable symbol
+    * @return 1 for the least probable symbol, 0 otherwise
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   private int decodeSymbol(int lpsFrequency) throws Exception{
+     int mpsFrequency = PROB_SCALE - lpsFrequency;
+     int slot = x0 & (PROB_SCALE - 1);
+     int lps = slot >= mpsFrequency ? 1: 0;
+     int frequency = lps == 1 ? lpsFrequency: mpsFrequency;
+     int start = lps == 1 ? mpsFrequency: 0;
+     int x = frequency * (x0 >>> PROB_BITS) + slot - start;
+     while(x < RANS_L){
+       x = (x << 8) | getByte();
+     }
+     x0 = x1;
+     x1 = x;
+     return(lps);
+   }
+ 
+   /**
+    * Updates the state of a context after coding a symbol, as the MQ coder does.
+    *
+    * @param context context of the symbol
+    * @param state state of the context before coding the symbol
+    * @param lps 1 when the least probable symbol was coded, 0 otherwise
+    */
+   private void update(int context, int state, int lps){
+     if(!updateInterval(ArithmeticCoder.STATE_PROB[state], lps)){
+       return;
+     }
+     if(lps == 0){
+       contextState[context] = ArithmeticCoder.STATE_TRANSITIONS_MPS[state];
+     }else{
+       if(ArithmeticCoder.STATE_CHANGE[state] == 1){
+         contextMPS[context] ^= 1;
+       }
+       contextState[context] = ArithmeticCoder.STATE_TRANSITIONS_LPS[state];
+     }
+   }
+ 
+   /**
+    * Updates the copy of the interval register after coding a symbol, as the MQ coder does.
+    *
+    * @param p probability of the least probable symbol, as the integer of the MQ coder
+    * @param lps 1 when the least probable symbol was coded, 0 otherwise
+    * @return true when the register has been renormalized (always after the least probable
+    * symbol)
+    */
+   private boolean updateInterval(int p, int lps){
+     A -= p;
+     if(lps == 0){
+       if(A >= (1 << 15)){
+         return(false);
+       }
+       if(A < p){
+         A = p;
+       }
+     }else if(A >= p){
+       A = p;
+     }
+     while(A < (1 << 15)){
+       A <<= 1;
+     }
+     return(true);
+   }
+ 
+   /**
+    * Converts a probability given as in <code>ArithmeticCoder.encodeBitProb</code> into the
+    * frequency of the least probable symbol.
+    *
+    * @param prob0 probability of the symbol 0
+    * @return frequency of the least probable symbol, in the range [1, PROB_SCALE / 2]
+    */
+   private static int probToFrequency(int prob0){
+     int frequency = ArithmeticCoder.MQToProbFixed(prob0, PROB_BITS);
+     return(frequency < 1 ? 1: (frequency > PROB_SCALE / 2 ? PROB_SCALE / 2: frequency));
+   }
+ 
+   /**
+    * Reads the next byte of the segment, or 0 when the end is reached (for decoding purposes).
+    *
+    * @return the byte read
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   private int getByte() throws Exception{
+     if(position < end){
+       return(stream.getByte(position++) & 0xFF);
+     }
+     return(0);
+   }
+ }
\ No newline at end of file
@@ -0,0 +1,251 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ import streams.ByteStream;
+ 
+ 
+ /**
+  * This class implements a multi-symbol range coder, a companion of the binary
+  * <code>ArithmeticCoder</code> for data such as bytes: each symbol is coded in a single step with
+  * the frequencies of an adaptive <code>FrequencyModel</code>, instead of with one binary decision
+  * per bit. The interval is kept in 32 bits and renormalized a byte at a time; carries are
+  * propagated through a cached byte and a count of pending 0xFF bytes, so each byte is written to
+  * the stream only once it is final.<br>
+  *
+  * Usage: once the object is created, the stream must be set with <code>changeStream</code> and the
+  * coder restarted. When encoding, the stream must be terminated calling <code>terminate</code>.
+  * The models are not owned by the coder, so many models (e.g., one per context) can be employed
+  * with the same coder.<br>
+  *
+  * Multithreading support: the object must be created and manipulated by a single thread. There
+  * can be many objects of this class running simultaneously as long as a single thread manipulates
+  * each object.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class RangeCoder{
+ 
+   /**
+    * Lower bound of the range after renormalization.
+    * <p>
+    * With totals of at most 2^16, the range divided by the total keeps 8 bits of precision.
+    */
+   private static final long TOP = 1L << 24;
+ 
+   /**
+    * Mask of the 32 bits of the registers.
+    */
+   private static final long MASK = 0xFFFFFFFFL;
+ 
+   /**
+    * ByteStream employed to write or read the bytes.
+    * <p>
+    * Set with <code>changeStream</code>.
+    */
+   private ByteStream stream = null;
+ 
+   /**
+    * Lower end of the interval (for encoding purposes).
+    * <p>
+    * 32 bits plus a carry bit.
+    */
+   private long low;
+ 
+   /**
+    * Size of the interval.
+    * <p>
+    * In the range [TOP, 2^32 - 1] between symbols.
+    */
+   private long range;
+ 
+   /**
+    * Position of the codeword within the interval (for decoding purposes).
+    * <p>
+    * 32 bits.
+    */
+   private long code;
+ 
+   /**
+    * Byte waiting for a possible carry (for encoding purposes).
+    * <p>
+    * The first byte written is always 0.
+    */
+   private int cache;
+ 
+   /**
+    * Number of bytes pending to be written: the cached byte and the 0xFF bytes that follow it
+    * (for encoding purposes).
+    * <p>
+    * At least 1.
+    */
+   private long cacheSize;
+ 
+   /**
+    * Position of the next byte read (for decoding purposes).
+    * <p>
+    * Bytes from <code>end</code> onwards are read as 0.
+    */
+   private int position;
+ 
+   /**
+    * End of the segment read (for decoding purposes).
+    * <p>
+    * Exclusive.
+    */
+   private int end;
+ 
+ 
+   /**
+    * Creates the coder. Before coding, the stream must be set with <code>changeStream</code>
+    * and the coder restarted.
+    */
+   public RangeCoder(){
+   }
+ 
+   /**
+    * Changes the current stream.
+    *
+    * @param stream the new ByteStream
+    */
+   public void changeStream(ByteStream stream){
+     this.stream = stream;
+   }
+ 
+   /**
+    * Restarts the registers of the coder for encoding. Bytes are appended to the stream.
+    */
+   public void restartEncoding(){
+     low = 0;
+     range = MASK;
+     cache = 0;
+     cacheSize = 1;
+   }
+ 
+   /**
+    * Restarts the registers of the coder for decoding the whole stream.
+    *
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void restartDecoding() throws Exception{
+     restartDecoding(0, (int) stream.getLength());
+   }
+ 
+   /**
+    * Restarts the registers of the coder for decoding a segment of the stream.
+    *
+    * @param begin first byte of the segment (inclusive)
+    * @param end last byte of the segment (exclusive)
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void restartDecoding(int begin, int end) throws Exception{
+     position = begin;
+     this.end = end;
+     range = MASK;
+     code = 0;
+     //The first byte is the initial cache of the encoder
+     for(int i = 0; i < 5; i++){
+       code = ((code << 8) | getByte()) & MASK;
+     }
+   }
+ 
+   /**
+    * Encodes a symbol and updates the model.
+    *
+    * @param symbol symbol to encode
+    * @param model model of the symbol
+    */
+   public void encodeSymbol(int symbol, FrequencyModel model){
+     encode(model.getCumulative(symbol), model.getFrequency(symbol), model.getTotal());
+     model.update(symbol);
+   }
+ 
+   /**
+    * Decodes a symbol and updates the model.
+    *
+    * @param model model of the symbol
+    * @return the symbol decoded
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public int decodeSymbol(FrequencyModel model) throws Exception{
+     int total = model.getTotal();
+     long r = range / total;
+     long target = code / r;
+     int symbol = model.findSymbol(target < total ? (int) target: total - 1);
+     code -= r * model.getCumulative(symbol);
+     range = r * model.getFrequency(symbol);
+     while(range < TOP){
+       code = ((code << 8) | getByte()) & MASK;
+       range <<= 8;
+     }
+     model.update(symbol);
+     return(symbol);
+   }
+ 
+   /**
+    * Encodes an interval of cumulative frequencies (for models other than
+    * <code>FrequencyModel</code>).
+    *
+    * @param cumulative sum of the frequencies of the symbols lower than the symbol
+    * @param frequency frequency of the symbol, at least 1
+    * @param total sum of all the frequencies, at most 2^16
+    */
+   public void encode(int cumulative, int frequency, int total){
+     long r = range / total;
+     low += r * cumulative;
+     range = r * frequency;
+     while(range < TOP){
+       range <<= 8;
+       shiftLow();
+     }
+   }
+ 
+   /**
+    * Terminates the current stream (for encoding purposes), writing the bytes that determine the
+    * interval.
+    */
+   public void terminate(){
+     for(int i = 0; i < 5; i++){
+       shiftLow();
+     }
+   }
+ 
+   /**
+    * Writes the top byte of <code>low</code>, resolving the carry of the pending bytes (for
+    * encoding purposes).
+    */
+   private void shiftLow(){
+     if((low < 0xFF000000L) || (low > MASK)){
+       int carry = (int) (low >>> 32);
+       int pending = cache;
+       do{
+         stream.putByte((byte) (pending + carry));
+         pending = 0xFF;
+       }while(--cacheSize != 0);
+       cache = (int) ((low >>> 24) & 0xFF);
+     }
+     cacheSize++;
+     low = (low & 0x00FFFFFFL) << 8;
+   }
+ 
+   /**
+    * Reads the next byte of the segment, or 0 when the end is reached (for decoding purposes).
+    *
+    * @return the byte read
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   private int getByte() throws Exception{
+     if(position < end){
+       return(stream.getByte(position++) & 0xFF);
+     }
+     return(0);
+   }
+ }
\ No newline at end of file
@@ -0,0 +1,128 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ 
+ /**
+  * This class refines the probabilities of the contexts of the <code>ArithmeticCoder</code> with
+  * an <code>AdaptiveProbabilityMap</code>, as an optional stage between the context models and the
+  * coder. The probability of the state of the context (<code>STATE_PROB</code>, which the 47
+  * states quantize coarsely) is mapped through the APM with the context and a small secondary
+  * context chosen by the caller (e.g., the value of a neighbour not included in the context), and
+  * the result, averaged with the input, is coded with <code>encodeBitProb</code>. The state of the
+  * context is then updated as usual with <code>updateContext</code>, so the context models do not
+  * change.<br>
+  *
+  * Usage: once the object is created, the bits coded through it employ <code>encodeBit</code> or
+  * <code>decodeBit</code>; other bits can be coded directly with the coder. <code>reset</code>
+  * must be called whenever the contexts of the coder are reset.<br>
+  *
+  * Multithreading support: the object must be created and manipulated by a single thread. There
+  * can be many objects of this class running simultaneously as long as a single thread manipulates
+  * each object.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class RefinedContextCoder{
+ 
+   /**
+    * Arithmetic coder employed, whose contexts are refined.
+    * <p>
+    * Set when the class is instantiated.
+    */
+   private ArithmeticCoder coder;
+ 
+   /**
+    * Number of secondary contexts.
+    * <p>
+    * Set when the class is instantiated.
+    */
+   private int numSecondaryContexts;
+ 
+   /**
+    * Map that refines the probabilities, with one set of intervals per context and secondary
+    * context.
+    * <p>
+    * Indexed as context * numSecondaryContexts + secondaryContext.
+    */
+   private AdaptiveProbabilityMap map;
+ 
+ 
+   /**
+    * Creates the refinement stage.
+    *
+    * @param coder arithmetic coder employed
+    * @param numContexts number of contexts of the coder refined, from 0
+    * @param numSecondaryContexts number of secondary contexts
+    */
+   public RefinedContextCoder(ArithmeticCoder coder, int numContexts, int numSecondaryContexts){
+     this.coder = coder;
+     this.numSecondaryContexts = numSecondaryContexts;
+     map = new AdaptiveProbabilityMap(numContexts * numSecondaryContexts);
+   }
+ 
+   /**
+    * Resets the map to the identity.
+    */
+   public void reset(){
+     map.reset();
+   }
+ 
+   /**
+    * Gets the refined probability of the symbol 0 of a context as the integer of the MQ coder.
+    * The map is then ready to be updated with the bit.
+    *
+    * @param context context of the bit
+    * @param secondaryContext secondary context of the bit, in the range
+    * [0, numSecondaryContexts - 1]
+    * @return probability as given by <code>ArithmeticCoder.prob0ToMQ</code>
+    */
+   public int getMQProbability(int context, int secondaryContext){
+     int probMQ = coder.getContextProbability(context);
+     int probLPS = ArithmeticCoder.MQToProbFixed(probMQ, LogisticMixer.PROB_BITS);
+     probLPS = probLPS < 1 ? 1: probLPS;
+     int prob0 = probMQ >= 0 ? (1 << LogisticMixer.PROB_BITS) - probLPS: probLPS;
+     int refined = map.refine(prob0, context * numSecondaryContexts + secondaryContext);
+     return(ArithmeticCoder.prob12ToMQ((prob0 + 3 * refined) >> 2));
+   }
+ 
+   /**
+    * Encodes a bit with the refined probability of its context and updates the context and the
+    * map.
+    *
+    * @param bit input
+    * @param context context of the bit
+    * @param secondaryContext secondary context of the bit, in the range
+    * [0, numSecondaryContexts - 1]
+    */
+   public void encodeBit(boolean bit, int context, int secondaryContext){
+     coder.encodeBitProb(bit, getMQProbability(context, secondaryContext));
+     map.update(bit);
+     coder.updateContext(bit, context);
+   }
+ 
+   /**
+    * Decodes a bit with the refined probability of its context and updates the context and the
+    * map.
+    *
+    * @param context context of the bit
+    * @param secondaryContext secondary context of the bit, in the range
+    * [0, numSecondaryContexts - 1]
+    * @return output bit
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public boolean decodeBit(int context, int secondaryContext) throws Exception{
+     boolean bit = coder.decodeBitProb(getMQProbability(context, secondaryContext));
+     map.update(bit);
+     coder.updateContext(bit, context);
+     return(bit);
+   }
+ }
\ No newline at end of file
@@ -0,0 +1,82 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ import streams.ByteStream;
+ 
+ 
+ /**
+  * This class writes and reads the length of a segment of a stream in a fixed number of bytes of
+  * 7 bits, most significant first. Since the most significant bit of each byte is 0, the length
+  * never forms a marker with the bytes around it. It is employed by the coders that place several
+  * segments in the same stream (e.g., the MEL segment of <code>Tier1Coder</code>, the MEL and VLC
+  * segments of <code>HTBlockCoder</code>, and the raw segment of
+  * <code>AdaptiveBypassCoder</code>).<br>
+  *
+  * Multithreading support: the class has no state, so it can be employed by many threads.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class SegmentLength{
+ 
+   /**
+    * Number of bytes employed to write a length.
+    * <p>
+    * Each byte carries 7 bits.
+    */
+   public static final int NUM_BYTES = 3;
+ 
+   /**
+    * Largest length that can be written.
+    * <p>
+    * 2^(7 * NUM_BYTES) - 1.
+    */
+   public static final int MAX_LENGTH = (1 << (7 * NUM_BYTES)) - 1;
+ 
+ 
+   /**
+    * The class is not instantiated.
+    */
+   private SegmentLength(){
+   }
+ 
+   /**
+    * Appends a length to a stream.
+    *
+    * @param stream stream where the length is appended
+    * @param length length of the segment, in the range [0, MAX_LENGTH]
+    * @throws Exception when the length is out of range
+    */
+   public static void write(ByteStream stream, int length) throws Exception{
+     if((length < 0) || (length > MAX_LENGTH)){
+       throw new Exception("Segment too long.");
+     }
+     for(int b = NUM_BYTES - 1; b >= 0; b--){
+       stream.putByte((byte) ((length >> (7 * b)) & 0x7F));
+     }
+   }
+ 
+   /**
+    * Reads a length from a stream.
+    *
+    * @param stream stream that contains the length
+    * @param position position of the first byte of the length in the stream
+    * @return length of the segment
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public static int read(ByteStream stream, int position) throws Exception{
+     int length = 0;
+     for(int b = 0; b < NUM_BYTES; b++){
+       length = (length << 7) | (stream.getByte(position + b) & 0x7F);
+     }
+     return(length);
+   }
+ }
\ No newline at end of file
@@ -0,0 +1,226 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ import streams.ByteStream;
+ 
+ 
+ /**
+  * This class implements a static (two-pass) context model for data with stable statistics. In
+  * the first pass, the encoder counts the 0s and 1s of each context; the probability of each
+  * context is then quantized, transmitted in a header of one byte per context, and employed
+  * without changes to code all the bits with <code>encodeBitProb</code> and
+  * <code>decodeBitProb</code>. There are no state transitions, so decoding does not write to the
+  * model.<br>
+  *
+  * The probabilities are quantized in the logistic (stretch) domain of
+  * <code>LogisticMixer</code> with 255 levels, which keeps the precision near 0 and 1, where
+  * most of the cost of skewed contexts is.<br>
+  *
+  * Usage: the encoder calls <code>count</code> for all the bits, <code>quantize</code>,
+  * <code>writeHeader</code> and then <code>encodeBit</code> for the same bits. The decoder calls
+  * <code>readHeader</code> and then <code>decodeBit</code>.<br>
+  *
+  * Multithreading support: once the probabilities are quantized or read, the object is not
+  * modified by <code>encodeBit</code> nor <code>decodeBit</code>, so many threads can code with
+  * the same object (each one with its own coder).<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class StaticModel{
+ 
+   /**
+    * Level of the quantized probabilities of the contexts with no bits counted.
+    * <p>
+    * Probability 1/2.
+    */
+   private static final int EQUIPROBABLE_LEVEL = 127;
+ 
+   /**
+    * Number of contexts.
+    * <p>
+    * Set when the class is instantiated.
+    */
+   private int numContexts;
+ 
+   /**
+    * Number of 0s counted in each context (for encoding purposes).
+    * <p>
+    * Set with <code>count</code>.
+    */
+   private int[] counts0;
+ 
+   /**
+    * Number of 1s counted in each context (for encoding purposes).
+    * <p>
+    * Set with <code>count</code>.
+    */
+   private int[] counts1;
+ 
+   /**
+    * Quantized probability of the symbol 0 of each context.
+    * <p>
+    * In the range [0, 254]; level q is the probability squash(16 * (q - 127)).
+    */
+   private int[] levels;
+ 
+   /**
+    * Probability of the symbol 0 of each context as the integer of the MQ coder.
+    * <p>
+    * Read-only while coding.
+    */
+   private int[] probsMQ;
+ 
+ 
+   /**
+    * Creates the model with no bits counted and all contexts equiprobable.
+    *
+    * @param numContexts number of contexts
+    */
+   public StaticModel(int numContexts){
+     this.numContexts = numContexts;
+     counts0 = new int[numContexts];
+     counts1 = new int[numContexts];
+     levels = new int[numContexts];
+     probsMQ = new int[numContexts];
+     reset();
+   }
+ 
+   /**
+    * Clears the counts and sets all contexts equiprobable.
+    */
+   public void reset(){
+     for(int c = 0; c < numContexts; c++){
+       counts0[c] = 0;
+       counts1[c] = 0;
+       levels[c] = EQUIPROBABLE_LEVEL;
+     }
+     computeProbabilities();
+   }
+ 
+   /**
+    * Counts a bit of a context (first pass of the encoder).
+    *
+    * @param bit bit that will be coded
+    * @param context context of the bit
+    */
+   public void count(boolean bit, int context){
+     if(bit){
+       counts1[context]++;
+     }else{
+       counts0[context]++;
+     }
+   }
+ 
+   /**
+    * Quantizes the probabilities of the contexts from the counts (for encoding purposes).
+    */
+   public void quantize(){
+     for(int c = 0; c < numContexts; c++){
+       long total = (long) counts0[c] + counts1[c];
+       if(total == 0){
+         levels[c] = EQUIPROBABLE_LEVEL;
+         continue;
+       }
+       long scaledCount0 = (long) counts0[c] << LogisticMixer.PROB_BITS;
+       int prob0 = (int) ((scaledCount0 + (total >> 1)) / total);
+       int maxProb = (1 << LogisticMixer.PROB_BITS) - 1;
+       prob0 = prob0 < 1 ? 1: (prob0 > maxProb ? maxProb: prob0);
+       //Nearest level in the stretch domain
+       int level = (LogisticMixer.stretch(prob0) + 2032 + 8) >> 4;
+       levels[c] = level < 0 ? 0: (level > 254 ? 254: level);
+     }
+     computeProbabilities();
+   }
+ 
+   /**
+    * Writes the quantized probabilities to a stream, one byte per context (for encoding purposes).
+    *
+    * @param stream stream where the header is appended
+    */
+   public void writeHeader(ByteStream stream){
+     for(int c = 0; c < numContexts; c++){
+       stream.putByte((byte) levels[c]);
+     }
+   }
+ 
+   /**
+    * Reads the quantized probabilities from a stream (for decoding purposes).
+    *
+    * @param stream stream that contains the header
+    * @param position position of the header in the stream
+    * @return position of the first byte after the header
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public int readHeader(ByteStream stream, int position) throws Exception{
+     for(int c = 0; c < numContexts; c++){
+       int level = stream.getByte(position++) & 0xFF;
+       if(level > 254){
+         throw new Exception("Invalid probability level in the header of the static model.");
+       }
+       levels[c] = level;
+     }
+     computeProbabilities();
+     return(position);
+   }
+ 
+   /**
+    * Gets the size of the header.
+    *
+    * @return number of bytes
+    */
+   public int getHeaderLength(){
+     return(numContexts);
+   }
+ 
+   /**
+    * Gets the quantized probability of the symbol 0 of a context as the integer of the MQ coder.
+    *
+    * @param context context of the symbol
+    * @return probability as given by <code>ArithmeticCoder.prob0ToMQ</code>
+    */
+   public int getMQProbability(int context){
+     return(probsMQ[context]);
+   }
+ 
+   /**
+    * Encodes a bit with the quantized probability of its context (second pass of the encoder).
+    *
+    * @param coder coder employed
+    * @param bit input
+    * @param context context of the bit
+    */
+   public void encodeBit(BinaryCoder coder, boolean bit, int context){
+     coder.encodeBitProb(bit, probsMQ[context]);
+   }
+ 
+   /**
+    * Decodes a bit with the quantized probability of its context.
+    *
+    * @param coder coder employed
+    * @param context context of the bit
+    * @return output bit
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public boolean decodeBit(BinaryCoder coder, int context) throws Exception{
+     return(coder.decodeBitProb(probsMQ[context]));
+   }
+ 
+   /**
+    * Computes the probabilities for the coder from the quantized levels.
+    */
+   private void computeProbabilities(){
+     for(int c = 0; c < numContexts; c++){
+       probsMQ[c] = LogisticMixer.squash((levels[c] - EQUIPROBABLE_LEVEL) << 4);
+     }
+     ArithmeticCoder.probsToMQ(probsMQ, LogisticMixer.PROB_BITS, probsMQ, numContexts);
+   }
+ }
\ No newline at end of file
@@ -0,0 +1,297 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ import java.util.concurrent.Callable;
+ import java.util.concurrent.ExecutionException;
+ import java.util.concurrent.ExecutorService;
+ import java.util.concurrent.Future;
+ import streams.ByteStream;
+ 
+ 
+ /**
+  * This class codes a page bitmap as a sequence of stripes of rows, each one coded with the
+  * <code>GenericRegionCoder</code> as a region by itself: the contexts are reset and the rows
+  * above the stripe are taken as 0 at the beginning of each stripe, and the arithmetic codeword
+  * of each stripe is terminated. The stripes are written one after the other to the same stream
+  * and the end of each one is recorded, so that the decoder can decode all of them at the same
+  * time, each in a different thread, writing the rows of the stripe to the shared page bitmap.
+  * The stripes employ disjoint rows, so the threads do not need to synchronize and the result is
+  * the same regardless of the number of threads.<br>
+  *
+  * Usage: once the object is created, pages can be encoded with <code>encode</code> (the end of
+  * the stripes is then available through <code>getStripeEnds</code>) and decoded with
+  * <code>decode</code>.<br>
+  *
+  * Multithreading support: the object must be created and manipulated by a single thread. There
+  * can be many objects of this class running simultaneously as long as a single thread manipulates
+  * each object. When an executor is given, the stripes are decoded by the threads of the executor,
+  * each one with its own <code>ArithmeticCoder</code>.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class StripedRegionCoder{
+ 
+   /**
+    * Coder of the stripes.
+    * <p>
+    * Not modified while coding, so it is shared by all the threads.
+    */
+   private GenericRegionCoder regionCoder;
+ 
+   /**
+    * Number of rows of each stripe.
+    * <p>
+    * The last stripe may have fewer rows.
+    */
+   private int stripeHeight;
+ 
+   /**
+    * Executor that decodes the stripes.
+    * <p>
+    * When null, the stripes are decoded by the calling thread.
+    */
+   private ExecutorService executor = null;
+ 
+   /**
+    * Arithmetic coder of each thread.
+    * <p>
+    * Created the first time that a thread codes a stripe.
+    */
+   private ThreadLocal<ArithmeticCoder> coders;
+ 
+   /**
+    * End of each stripe of the last page encoded, in bytes from the beginning of the page.
+    * <p>
+    * Grown as needed.
+    */
+   private int[] stripeEnds = new int[0];
+ 
+ 
+   /**
+    * Creates a coder that decodes the stripes with the calling thread.
+    *
+    * @param template template employed, in the range [0, 3]
+    * @param typicalPrediction true to employ typical prediction (TPGDON)
+    * @param stripeHeight number of rows of each stripe
+    */
+   public StripedRegionCoder(int template, boolean typicalPrediction, int stripeHeight){
+     this(template, typicalPrediction, stripeHeight, null);
+   }
+ 
+   /**
+    * Creates a coder that decodes the stripes in parallel.
+    *
+    * @param template template employed, in the range [0, 3]
+    * @param typicalPrediction true to employ typical prediction (TPGDON)
+    * @param stripeHeight number of rows of each stripe
+    * @param executor executor that decodes the stripes, or null to decode them with the calling
+    * thread
+    */
+   public StripedRegionCoder(int template, boolean typicalPrediction, int stripeHeight,
+   ExecutorService executor){
+     this.regionCoder = new GenericRegionCoder(template, typicalPrediction);
+     this.stripeHeight = stripeHeight;
+     this.executor = executor;
+     final int numContexts = regionCoder.getNumContexts();
+     coders = new ThreadLocal<ArithmeticCoder>(){
+       protected ArithmeticCoder initialValue(){
+         ArithmeticCoder coder = new ArithmeticCoder(numContexts);
+         coder.setSparseReset(true);
+         return(coder);
+       }
+     };
+   }
+ 
+   /**
+    * Sets the position of the AT pixels (see <code>GenericRegionCoder.setATPixels</code>).
+    *
+    * @param atPixels pairs of x and y offsets of the AT pixels
+    * @throws Exception when some AT pixel is not causal
+    */
+   public void setATPixels(int[] atPixels) throws Exception{
+     regionCoder.setATPixels(atPixels);
+   }
+ 
+   /**
+    * Gets the number of stripes of a page.
+    *
+    * @param height height of the page
+    * @return number of stripes
+    */
+   public int getNumStripes(int height){
+     return((height + stripeHeight - 1) / stripeHeight);
+   }
+ 
+   /**
+    * Encodes a page.
+    *
+    * @param bitmap packed rows of the page (see <code>GenericRegionCoder</code>)
+    * @param width width of the page
+    * @param height height of the page
+    * @param stream stream where the page is written
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void encode(int[] bitmap, int width, int height, ByteStream stream) throws Exception{
+     int numStripes = getNumStripes(height);
+     if(stripeEnds.length < numStripes){
+       stripeEnds = new int[numStripes];
+     }
+     ArithmeticCoder coder = coders.get();
+     coder.changeStream(stream);
+     int begin = (int) stream.getLength();
+     for(int stripe = 0; stripe < numStripes; stripe++){
+       int firstRow = stripe * stripeHeight;
+       coder.reset();
+       coder.restartEncoding();
+       regionCoder.encode(bitmap, width, firstRow, Math.min(stripeHeight, height - firstRow), coder);
+       coder.terminate();
+       stripeEnds[stripe] = (int) stream.getLength() - begin;
+     }
+   }
+ 
+   /**
+    * Gets the end of each stripe of the last page encoded, in bytes from the beginning of the
+    * page.
+    *
+    * @return array whose first <code>getNumStripes(height)</code> positions are valid. It is
+    * overwritten when the next page is encoded
+    */
+   public int[] getStripeEnds(){
+     return(stripeEnds);
+   }
+ 
+   /**
+    * Decodes a page. The page must begin at the first byte of the stream.
+    *
+    * @param stream stream from which the page is read
+    * @param width width of the page
+    * @param height height of the page
+    * @param stripeEnds end of each stripe, as given by <code>getStripeEnds</code> when encoding
+    * @param bitmap array of at least height * GenericRegionCoder.getRowWords(width) words where
+    * the packed rows of the page are stored
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void decode(ByteStream stream, int width, int height, int[] stripeEnds, int[] bitmap)
+   throws Exception{
+     int numStripes = getNumStripes(height);
+     if((executor == null) || (numStripes == 1)){
+       for(int stripe = 0; stripe < numStripes; stripe++){
+         new StripeDecoder(stream, width, height, stripeEnds, bitmap, stripe).call();
+       }
+       return;
+     }
+ 
+     Future<?>[] futures = new Future<?>[numStripes];
+     for(int stripe = 1; stripe < numStripes; stripe++){
+       futures[stripe] = executor.submit(
+         new StripeDecoder(stream, width, height, stripeEnds, bitmap, stripe));
+     }
+     Exception exception = null;
+     try{
+       new StripeDecoder(stream, width, height, stripeEnds, bitmap, 0).call();
+     }catch(Exception e){
+       exception = e;
+     }
+     //All the stripes must finish before returning, even when one fails
+     for(int stripe = 1; stripe < numStripes; stripe++){
+       try{
+         futures[stripe].get();
+       }catch(ExecutionException e){
+         if(exception == null){
+           exception = e.getCause() instanceof Exception ? (Exception) e.getCause(): e;
+         }
+       }
+     }
+     if(exception != null){
+       throw exception;
+     }
+   }
+ 
+   /**
+    * Decodes one stripe of a page with the arithmetic coder of the current thread.
+    */
+   private final class StripeDecoder implements Callable<Void>{
+ 
+     /**
+      * Stream from which the page is read.
+      * <p>
+      * Only read, so it is shared by all the stripes.
+      */
+     private ByteStream stream;
+ 
+     /**
+      * Width of the page.
+      */
+     private int width;
+ 
+     /**
+      * Height of the page.
+      */
+     private int height;
+ 
+     /**
+      * End of each stripe in the stream.
+      * <p>
+      * See <code>getStripeEnds</code>.
+      */
+     private int[] stripeEnds;
+ 
+     /**
+      * Packed rows of the page.
+      * <p>
+      * Each stripe writes only its own rows.
+      */
+     private int[] bitmap;
+ 
+     /**
+      * Stripe decoded.
+      */
+     private int stripe;
+ 
+ 
+     /**
+      * Creates the decoder of a stripe.
+      *
+      * @param stream stream from which the page is read
+      * @param width width of the page
+      * @param height height of the page
+      * @param stripeEnds end of each stripe in the stream
+      * @param bitmap packed rows of the page
+      * @param stripe stripe decoded
+      */
+     StripeDecoder(ByteStream stream, int width, int height, int[] stripeEnds, int[] bitmap,
+     int stripe){
+       this.stream = stream;
+       this.width = width;
+       this.height = height;
+       this.stripeEnds = stripeEnds;
+       this.bitmap = bitmap;
+       this.stripe = stripe;
+     }
+ 
+     /**
+      * Decodes the stripe.
+      *
+      * @return null
+      * @throws Exception when some problem manipulating the stream occurs
+      */
+     public Void call() throws Exception{
+       ArithmeticCoder coder = coders.get();
+       coder.changeStream(stream);
+       coder.reset();
+       coder.restartDecoding(stripe > 0 ? stripeEnds[stripe - 1]: 0, stripeEnds[stripe]);
+       int firstRow = stripe * stripeHeight;
+       regionCoder.decode(coder, width, firstRow, Math.min(stripeHeight, height - firstRow), bitmap);
+       return(null);
+     }
+   }
+ }
\ No newline at end of file
@@ -0,0 +1,95 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ 
+ /**
+  * This class implements the symbol ID coding procedure of the JBIG2 standard (IAID, ITU-T T.88,
+  * annex A.3). A symbol ID is coded with a fixed number of bits (the code length), from the most
+  * significant one, each bit with the <code>ArithmeticCoder</code> in the context given by the
+  * bits coded before it, so the procedure employs 2^codeLength contexts.<br>
+  *
+  * As in the <code>IntegerCoder</code>, the contexts belong to a bank of the
+  * <code>ArithmeticCoder</code> starting at a given offset, so that the procedure can share the
+  * coder with the other procedures of a region.<br>
+  *
+  * Multithreading support: the object holds no state other than its bank, so it can be employed
+  * by many threads as long as each thread employs its own <code>ArithmeticCoder</code>.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class SymbolIDCoder{
+ 
+   /**
+    * First context of the bank in the <code>ArithmeticCoder</code>.
+    * <p>
+    * The bank spans <code>getNumContexts()</code> contexts.
+    */
+   private int contextOffset;
+ 
+   /**
+    * Number of bits of the symbol IDs.
+    * <p>
+    * In the range [0, 30].
+    */
+   private int codeLength;
+ 
+ 
+   /**
+    * Creates the procedure.
+    *
+    * @param contextOffset first context of the bank in the <code>ArithmeticCoder</code>
+    * @param codeLength number of bits of the symbol IDs (SBSYMCODELEN)
+    */
+   public SymbolIDCoder(int contextOffset, int codeLength){
+     this.contextOffset = contextOffset;
+     this.codeLength = codeLength;
+   }
+ 
+   /**
+    * Gets the number of contexts of the bank.
+    *
+    * @return 2 raised to the code length
+    */
+   public int getNumContexts(){
+     return(ArithmeticCoder.BIT_MASKS[codeLength]);
+   }
+ 
+   /**
+    * Encodes a symbol ID.
+    *
+    * @param coder coder employed, already restarted for encoding
+    * @param id symbol ID, in the range [0, 2^codeLength - 1]
+    */
+   public void encode(BinaryCoder coder, int id){
+     int prev = 1;
+     for(int b = codeLength - 1; b >= 0; b--){
+       int bit = (id >> b) & 1;
+       coder.encodeBitContext(bit != 0, contextOffset + prev);
+       prev = (prev << 1) | bit;
+     }
+   }
+ 
+   /**
+    * Decodes a symbol ID.
+    *
+    * @param coder coder employed, already restarted for decoding
+    * @return the symbol ID decoded
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public int decode(BinaryCoder coder) throws Exception{
+     int prev = 1;
+     for(int b = codeLength; b > 0; b--){
+       prev = (prev << 1) | (coder.decodeBitContext(contextOffset + prev) ? 1: 0);
+     }
+     return(prev - ArithmeticCoder.BIT_MASKS[codeLength]);
+   }
+ }
\ No newline at end of file
@@ -0,0 +1,1260 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ import java.util.concurrent.CountDownLatch;
+ import java.util.concurrent.ExecutorService;
+ import java.util.concurrent.Future;
+ import java.util.concurrent.atomic.AtomicInteger;
+ import java.util.concurrent.atomic.AtomicIntegerArray;
+ import java.util.concurrent.atomic.AtomicReference;
+ import java.util.concurrent.atomic.AtomicReferenceArray;
+ import java.util.concurrent.locks.LockSupport;
+ import streams.ByteStream;
+ 
+ 
+ /**
+  * This class implements the bit-plane coder of the JPEG2000 standard (Tier-1 of EBCOT). Each
+  * code-block is coded from the most significant bit plane to the least significant one through
+  * the significance propagation, magnitude refinement and cleanup coding passes, employing the
+  * 19 contexts defined in the standard. The symbols are coded with an <code>ArithmeticCoder</code>.<br>
+  *
+  * The state of the samples is kept in bit-packed words, one for each column of a stripe (4 rows),
+  * holding the significance, sign, visited and refined bits of its 4 samples. The word array is
+  * padded with one column at each side and one stripe above and below. The significance of the
+  * column and of the last and first rows of the stripes above and below is gathered in a 6-bit
+  * value, so that the 3x3 neighbourhood of any sample of the stripe is obtained from the values of
+  * 3 consecutive columns with shifts, and the contexts through a table lookup. These values slide
+  * along the stripe, so each column is gathered once per pass.<br>
+  *
+  * When encoding, the symbols of each stripe are collected with their contexts and coded at once
+  * through <code>ArithmeticCoder.encodeBitsContext</code>.<br>
+  *
+  * The options of the standard that reset the contexts and terminate the coder at the end of each
+  * pass, and that form vertically causal contexts, are supported (see <code>setOptions</code>).
+  * When the first two are employed, the passes of a code-block can be decoded in parallel. The
+  * run-length decisions of the cleanup pass can also be coded with a <code>MELCoder</code>, which
+  * codes the long runs of insignificant columns of the low bit planes with a fraction of a bit.<br>
+  *
+  * Usage: the same object should be employed to code all the code-blocks, since the state array
+  * and the coder are reused. Samples are given in two's complement, row by row.<br>
+  *
+  * Multithreading support: the object must be created and manipulated by a single thread. There
+  * can be many objects of this class running simultaneously as long as a single thread manipulates
+  * each object.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class Tier1Coder implements BlockCoder{
+ 
+   /**
+    * Subband LL (low-pass horizontally and vertically).
+    */
+   public static final int SUBBAND_LL = 0;
+ 
+   /**
+    * Subband HL (high-pass horizontally, low-pass vertically).
+    */
+   public static final int SUBBAND_HL = 1;
+ 
+   /**
+    * Subband LH (low-pass horizontally, high-pass vertically).
+    */
+   public static final int SUBBAND_LH = 2;
+ 
+   /**
+    * Subband HH (high-pass horizontally and vertically).
+    */
+   public static final int SUBBAND_HH = 3;
+ 
+   /**
+    * Number of contexts employed by the coder.
+    * <p>
+    * 9 significance, 5 sign, 3 refinement, 1 run-length and 1 uniform context.
+    */
+   public static final int NUM_CONTEXTS = 19;
+ 
+   /**
+    * First context of the magnitude refinement.
+    * <p>
+    * Contexts 14, 15 and 16 are employed in the first refinement without and with significant
+    * neighbours, and in the subsequent refinements, respectively.
+    */
+   private static final int CONTEXT_REFINEMENT = 14;
+ 
+   /**
+    * Context of the run-length mode of the cleanup pass.
+    */
+   private static final int CONTEXT_RUN = 17;
+ 
+   /**
+    * Context employed to code the position of the first significant sample after a run.
+    */
+   private static final int CONTEXT_UNIFORM = 18;
+ 
+   /**
+    * Option that resets the contexts at the end of each coding pass.
+    */
+   public static final int OPTION_RESET = 1;
+ 
+   /**
+    * Option that terminates the arithmetic coder at the end of each coding pass, so that each pass
+    * is decoded from its own segment of the stream.
+    */
+   public static final int OPTION_TERMINATE_ALL = 2;
+ 
+   /**
+    * Option that forms the contexts of a stripe without the significance of the stripe below
+    * (vertically causal contexts).
+    */
+   public static final int OPTION_CAUSAL = 4;
+ 
+   /**
+    * Option that codes the run-length decisions of the cleanup pass with a <code>MELCoder</code>
+    * instead of with the arithmetic coder. The MEL bytes are placed before the arithmetic coded
+    * bytes, preceded by their length in 3 bytes of 7 bits.
+    */
+   public static final int OPTION_MEL_RUNS = 8;
+ 
+   /**
+    * Position of the negative sign bits in the state words.
+    * <p>
+    * Bits 0 to 3 of a word are the significance of the rows 0 to 3 of the stripe column.
+    */
+   private static final int NEGATIVE_SHIFT = 4;
+ 
+   /**
+    * Position of the bits indicating that the sample has been coded in the significance
+    * propagation pass of the current bit plane.
+    */
+   private static final int VISITED_SHIFT = 8;
+ 
+   /**
+    * Position of the bits indicating that the sample has been refined at least once.
+    */
+   private static final int REFINED_SHIFT = 12;
+ 
+   /**
+    * Maximum number of symbols coded in a stripe column by one coding pass.
+    * <p>
+    * Reached by a cleanup pass that codes a run interruption.
+    */
+   private static final int MAX_SYMBOLS_PER_COLUMN = 10;
+ 
+   /**
+    * Significance context for each subband and neighbourhood.
+    * <p>
+    * Indexed as [subband][neighbourhood], the neighbourhood being the 3x3 significance bits with
+    * rows in groups of 3 bits, from right to left: NW, W, SW, N, sample, S, NE, E, and SE.
+    * Contexts are in the range [0, 8].
+    */
+   private static final int[][] SIGNIFICANCE_CONTEXTS = {
+     buildSignificanceContexts(SUBBAND_LL), buildSignificanceContexts(SUBBAND_HL),
+     buildSignificanceContexts(SUBBAND_LH), buildSignificanceContexts(SUBBAND_HH)};
+ 
+   /**
+    * Sign context and sign prediction for each pattern of the horizontal and vertical neighbours.
+    * <p>
+    * Indexed by the significance bits N, W, S, E in the 4 least significant bits and the sign
+    * bits N, W, S, E in the next 4 bits. The 5 least significant bits of each entry are the
+    * context, in the range [9, 13], and the next bit the prediction XORed with the sign.
+    */
+   private static final int[] SIGN_CONTEXTS = buildSignContexts();
+ 
+   /**
+    * Coder employed to code the symbols.
+    * <p>
+    * Reused for all the code-blocks.
+    */
+   private ArithmeticCoder coder = new ArithmeticCoder(NUM_CONTEXTS);
+ 
+   /**
+    * State words of the stripe columns of the current code-block, padded with one column at each
+    * side and one stripe above and below.
+    * <p>
+    * The word of column x of stripe s is at position (s + 1) * stride + x + 1.
+    */
+   private int[] state = new int[(16 + 2) * (64 + 2)];
+ 
+   /**
+    * Width of the current code-block.
+    * <p>
+    * Set when the code-block is coded.
+    */
+   private int width;
+ 
+   /**
+    * Height of the current code-block.
+    * <p>
+    * Set when the code-block is coded.
+    */
+   private int height;
+ 
+   /**
+    * Number of stripes of the current code-block.
+    * <p>
+    * Equal to ceil(height / 4).
+    */
+   private int numStripes;
+ 
+   /**
+    * Distance between the words of two consecutive stripes.
+    * <p>
+    * Equal to width + 2.
+    */
+   private int stride;
+ 
+   /**
+    * Significance contexts of the subband of the current code-block.
+    * <p>
+    * One of the arrays of <code>SIGNIFICANCE_CONTEXTS</code>.
+    */
+   private int[] significanceContexts;
+ 
+   /**
+    * Number of magnitude bit planes of the current code-block.
+    * <p>
+    * 0 when all samples are 0.
+    */
+   private int numBitPlanes;
+ 
+   /**
+    * Number of coding passes of the current code-block.
+    * <p>
+    * 3 * numBitPlanes - 2 when encoding, or less when the decoded stream is truncated.
+    */
+   private int numPasses;
+ 
+   /**
+    * Symbols of the current stripe waiting to be encoded.
+    * <p>
+    * Either 0 or 1.
+    */
+   private int[] batchBits = new int[MAX_SYMBOLS_PER_COLUMN * 64];
+ 
+   /**
+    * Contexts of the symbols in <code>batchBits</code>.
+    * <p>
+    * In the range [0, NUM_CONTEXTS - 1].
+    */
+   private int[] batchContexts = new int[MAX_SYMBOLS_PER_COLUMN * 64];
+ 
+   /**
+    * Coding options.
+    * <p>
+    * Combination of the <code>OPTION_*</code> constants.
+    */
+   private int options = 0;
+ 
+   /**
+    * Mask applied to the significance of the stripe below in <code>significanceColumn</code>.
+    * <p>
+    * 0 with <code>OPTION_CAUSAL</code>, 1 otherwise.
+    */
+   private int belowMask = 1;
+ 
+   /**
+    * Indicates that the run-length decisions are coded with <code>mel</code>.
+    * <p>
+    * Set by <code>OPTION_MEL_RUNS</code>.
+    */
+   private boolean melRuns = false;
+ 
+   /**
+    * Coder of the run-length decisions with <code>OPTION_MEL_RUNS</code>.
+    * <p>
+    * An event 1 indicates that the run is interrupted by a significant sample.
+    */
+   private MELCoder mel = new MELCoder();
+ 
+   /**
+    * Stream where the MEL bytes are written before being placed in the code-block.
+    * <p>
+    * Emptied for each code-block.
+    */
+   private ByteStream melStream = new ByteStream();
+ 
+   /**
+    * Stream where the arithmetic coded bytes are written with <code>OPTION_MEL_RUNS</code>, before
+    * being placed in the code-block after the MEL bytes.
+    * <p>
+    * Emptied for each code-block.
+    */
+   private ByteStream mqStream = new ByteStream();
+ 
+   /**
+    * End of each coding pass of the last code-block encoded.
+    * <p>
+    * See <code>getPassEnds</code>. Up to 3 * 32 - 2 passes.
+    */
+   private int[] passEnds = new int[3 * 32];
+ 
+   /**
+    * Executor that runs the coding passes of the pipelined decoder.
+    * <p>
+    * Null when the passes are decoded sequentially.
+    */
+   private ExecutorService executor = null;
+ 
+   /**
+    * Coder of each coding pass of the pipelined decoder.
+    * <p>
+    * Grown when needed.
+    */
+   private ArithmeticCoder[] passCoders = new ArithmeticCoder[0];
+ 
+ 
+   /**
+    * Creates a coder for code-blocks of any size. Memory is allocated for code-blocks of
+    * 64x64 samples and grown when larger code-blocks are coded.
+    */
+   public Tier1Coder(){
+   }
+ 
+   /**
+    * Creates a coder that decodes the coding passes of a code-block in a pipeline, each pass being
+    * decoded by a different thread of the executor. The pipeline is employed only when the options
+    * <code>OPTION_RESET</code> and <code>OPTION_TERMINATE_ALL</code> are set (otherwise each pass
+    * depends on the coder state left by the previous one). A pass decodes a stripe once the previous
+    * pass has finished the stripe below it, so that the neighbourhood of the stripe is final.<br>
+    *
+    * The calling thread also decodes passes, and passes are claimed in order by the threads that
+    * run them, so any executor can be employed, also one shared with other work. Passes waiting
+    * for the previous one are parked.
+    *
+    * @param executor executor that runs the coding passes
+    */
+   public Tier1Coder(ExecutorService executor){
+     this.executor = executor;
+   }
+ 
+   /**
+    * Sets the coding options employed for the next code-blocks. The decoder must employ the same
+    * options as the encoder.
+    *
+    * @param options combination of the <code>OPTION_*</code> constants, or 0 for none
+    */
+   public void setOptions(int options){
+     this.options = options;
+     this.belowMask = (options & OPTION_CAUSAL) != 0 ? 0: 1;
+     this.melRuns = (options & OPTION_MEL_RUNS) != 0;
+   }
+ 
+   /**
+    * Encodes a code-block.
+    *
+    * @param samples samples of the code-block, row by row, in two's complement
+    * @param width width of the code-block
+    * @param height height of the code-block
+    * @param subband subband to which the code-block belongs (SUBBAND_LL, SUBBAND_HL, SUBBAND_LH,
+    * or SUBBAND_HH)
+    * @param stream stream where the code-block is written, from its first byte (the previous
+    * content of the stream is removed)
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void encode(int[] samples, int width, int height, int subband, ByteStream stream) throws Exception{
+     stream.removeBytes((int) stream.getLength());
+     prepare(width, height, subband);
+     int maxMagnitude = 0;
+     for(int s = 0; s < width * height; s++){
+       maxMagnitude |= samples[s] < 0 ? -samples[s]: samples[s];
+     }
+     numBitPlanes = 32 - Integer.numberOfLeadingZeros(maxMagnitude);
+     numPasses = numBitPlanes > 0 ? 3 * numBitPlanes - 2: 0;
+     if(numBitPlanes == 0){
+       return;
+     }
+ 
+     ByteStream mqStream = stream;
+     if(melRuns){
+       mqStream = this.mqStream;
+       mqStream.removeBytes((int) mqStream.getLength());
+       melStream.removeBytes((int) melStream.getLength());
+       mel.changeStream(melStream);
+       mel.restartEncoding();
+     }
+     coder.changeStream(mqStream);
+     coder.restartEncoding();
+     resetContexts(coder);
+     for(int pass = 0; pass < numPasses; pass++){
+       int bitPlane = numBitPlanes - 1 - (pass + 2) / 3;
+       for(int stripe = 0; stripe < numStripes; stripe++){
+         switch(pass % 3){
+         case 0:
+           encodeCleanupStripe(samples, bitPlane, stripe);
+           break;
+         case 1:
+           encodeSignificanceStripe(samples, bitPlane, stripe);
+           break;
+         default:
+           encodeRefinementStripe(samples, bitPlane, stripe);
+         }
+       }
+ 
+       if(((options & OPTION_TERMINATE_ALL) != 0) || (pass == numPasses - 1)){
+         coder.terminate();
+         passEnds[pass] = (int) mqStream.getLength();
+         if(pass < numPasses - 1){
+           coder.restartEncoding();
+         }
+       }else{
+         passEnds[pass] = (int) mqStream.getLength() + coder.remainingBytes();
+       }
+       if((options & OPTION_RESET) != 0){
+         resetContexts(coder);
+       }
+     }
+     //The estimated ends of the passes not terminated can exceed the final length or decrease
+     int passEnd = (int) mqStream.getLength();
+     for(int pass = numPasses - 1; pass >= 0; pass--){
+       passEnd = passEnds[pass] < passEnd ? passEnds[pass]: passEnd;
+       passEnds[pass] = passEnd;
+     }
+ 
+     if(melRuns){
+       mel.terminate();
+       int melLength = (int) melStream.getLength();
+       SegmentLength.write(stream, melLength);
+       for(int b = 0; b < melLength; b++){
+         stream.putByte(melStream.getByte(b));
+       }
+       for(int b = 0; b < (int) mqStream.getLength(); b++){
+         stream.putByte(mqStream.getByte(b));
+       }
+       for(int pass = 0; pass < numPasses; pass++){
+         passEnds[pass] += SegmentLength.NUM_BYTES + melLength;
+       }
+     }
+   }
+ 
+   /**
+    * Decodes a code-block that has been encoded without <code>OPTION_TERMINATE_ALL</code>. Bits of
+    * the bit planes not decoded are set to 0.
+    *
+    * @param stream stream from which the code-block is read
+    * @param width width of the code-block
+    * @param height height of the code-block
+    * @param subband subband to which the code-block belongs (SUBBAND_LL, SUBBAND_HL, SUBBAND_LH,
+    * or SUBBAND_HH)
+    * @param numBitPlanes number of magnitude bit planes of the code-block
+    * @param numPasses number of coding passes to decode, at most 3 * numBitPlanes - 2
+    * @param samples array where the samples are stored, row by row, in two's complement
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void decode(ByteStream stream, int width, int height, int subband, int numBitPlanes,
+   int numPasses, int[] samples) throws Exception{
+     decode(stream, width, height, subband, numBitPlanes, numPasses, null, samples);
+   }
+ 
+   /**
+    * Decodes a code-block. Bits of the bit planes not decoded are set to 0. The code-block must
+    * begin at the first byte of the stream.
+    *
+    * @param stream stream from which the code-block is read
+    * @param width width of the code-block
+    * @param height height of the code-block
+    * @param subband subband to which the code-block belongs (SUBBAND_LL, SUBBAND_HL, SUBBAND_LH,
+    * or SUBBAND_HH)
+    * @param numBitPlanes number of magnitude bit planes of the code-block
+    * @param numPasses number of coding passes to decode, at most 3 * numBitPlanes - 2
+    * @param passEnds end of the segment of each coding pass in the stream (see
+    * <code>getPassEnds</code>). Only employed with <code>OPTION_TERMINATE_ALL</code>, it can be null otherwise
+    * @param samples array where the samples are stored, row by row, in two's complement
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public void decode(ByteStream stream, int width, int height, int subband, int numBitPlanes,
+   int numPasses, int[] passEnds, int[] samples) throws Exception{
+     prepare(width, height, subband);
+     this.numBitPlanes = numBitPlanes;
+     this.numPasses = numPasses;
+     for(int s = 0; s < width * height; s++){
+       samples[s] = 0;
+     }
+     if(numPasses <= 0){
+       return;
+     }
+ 
+     int begin = 0;
+     if(melRuns){
+       begin = SegmentLength.NUM_BYTES + SegmentLength.read(stream, 0);
+       mel.changeStream(stream);
+       mel.restartDecoding(SegmentLength.NUM_BYTES, begin);
+     }
+     boolean terminateAll = (options & OPTION_TERMINATE_ALL) != 0;
+     boolean resetAll = (options & OPTION_RESET) != 0;
+     if((executor != null) && terminateAll && resetAll && !melRuns && (numPasses > 1)){
+       decodePipelined(stream, passEnds, samples);
+     }else{
+       coder.changeStream(stream);
+       for(int pass = 0; pass < numPasses; pass++){
+         if(terminateAll){
+           coder.restartDecoding(pass > 0 ? passEnds[pass - 1]: begin, passEnds[pass]);
+         }else if(pass == 0){
+           coder.restartDecoding(begin, (int) stream.getLength());
+         }
+         if(resetAll || (pass == 0)){
+           resetContexts(coder);
+         }
+         for(int stripe = 0; stripe < numStripes; stripe++){
+           decodeStripe(coder, samples, pass, stripe);
+         }
+       }
+     }
+     applySigns(samples);
+   }
+ 
+   /**
+    * Gets the number of magnitude bit planes of the last code-block coded.
+    *
+    * @return number of bit planes
+    */
+   public int getNumBitPlanes(){
+     return(numBitPlanes);
+   }
+ 
+   /**
+    * Gets the number of coding passes of the last code-block coded.
+    *
+    * @return number of coding passes
+    */
+   public int getNumPasses(){
+     return(numPasses);
+   }
+ 
+   /**
+    * Gets the end of each coding pass of the last code-block encoded, in bytes from the beginning
+    * of the code-block. With <code>OPTION_TERMINATE_ALL</code> it is the end of the segment of the
+    * pass; otherwise it is an estimate of the length needed to decode up to the pass (a valid
+    * truncation point), except for the last pass, which is exact. The ends are non-decreasing and
+    * never exceed the length of the code-block.
+    *
+    * @return array whose first <code>getNumPasses()</code> positions are valid. It is overwritten
+    * when the next code-block is encoded
+    */
+   public int[] getPassEnds(){
+     return(passEnds);
+   }
+ 
+   /**
+    * Decodes a stripe of a coding pass.
+    *
+    * @param coder coder from which the symbols are decoded
+    * @param samples magnitudes of the code-block decoded so far
+    * @param pass coding pass, 0 being the first cleanup pass
+    * @param stripe stripe decoded
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   private void decodeStripe(ArithmeticCoder coder, int[] samples, int pass, int stripe) throws Exception{
+     int bitPlane = numBitPlanes - 1 - (pass + 2) / 3;
+     switch(pass % 3){
+     case 0:
+       decodeCleanupStripe(coder, samples, bitPlane, stripe);
+       break;
+     case 1:
+       decodeSignificanceStripe(coder, samples, bitPlane, stripe);
+       break;
+     default:
+       decodeRefinementStripe(coder, samples, bitPlane, stripe);
+     }
+   }
+ 
+   /**
+    * Decodes the coding passes of the current code-block in a pipeline. The passes are claimed in
+    * order by the calling thread and by the tasks submitted to the executor, and the calling
+    * thread returns once all of them have finished.
+    *
+    * @param stream stream from which the code-block is read
+    * @param passEnds end of the segment of each coding pass in the stream
+    * @param samples magnitudes of the code-block
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   private void decodePipelined(ByteStream stream, int[] passEnds, int[] samples) throws Exception{
+     if(passCoders.length < numPasses){
+       ArithmeticCoder[] newCoders = new ArithmeticCoder[numPasses];
+       System.arraycopy(passCoders, 0, newCoders, 0, passCoders.length);
+       for(int pass = passCoders.length; pass < numPasses; pass++){
+         newCoders[pass] = new ArithmeticCoder(NUM_CONTEXTS);
+       }
+       passCoders = newCoders;
+     }
+     PassPipeline pipeline = new PassPipeline(stream, passEnds, samples, numPasses);
+     Future<?>[] helpers = new Future<?>[numPasses - 1];
+     for(int h = 0; h < helpers.length; h++){
+       helpers[h] = executor.submit(pipeline);
+     }
+     pipeline.run();
+     pipeline.finished.await();
+     //Helpers that have not started yet would find no passes left
+     for(int h = 0; h < helpers.length; h++){
+       helpers[h].cancel(false);
+     }
+     Exception exception = pipeline.failure.get();
+     if(exception != null){
+       throw exception;
+     }
+   }
+ 
+   /**
+    * Decodes the coding passes of a code-block in a pipeline. Each thread that runs the pipeline
+    * claims the next pass not decoded yet until none is left. Since passes are claimed in order,
+    * the pass that a pass waits for has always been claimed by a running thread, so the pipeline
+    * progresses whatever the order in which the executor runs its tasks, even when the calling
+    * thread is the only one. Before each stripe, a pass waits for the previous pass parked, and
+    * it is unparked when the previous pass finishes a stripe.
+    */
+   private final class PassPipeline implements Runnable{
+ 
+     /**
+      * Stream from which the code-block is read.
+      * <p>
+      * Only read, so it is shared by all the passes.
+      */
+     private ByteStream stream;
+ 
+     /**
+      * End of the segment of each coding pass in the stream.
+      * <p>
+      * See <code>getPassEnds</code>.
+      */
+     private int[] passEnds;
+ 
+     /**
+      * Magnitudes of the code-block.
+      * <p>
+      * Each pass writes only the stripes that no other pass is accessing.
+      */
+     private int[] samples;
+ 
+     /**
+      * Number of coding passes of the code-block.
+      * <p>
+      * Copied, so that a helper that starts after the code-block has been decoded does not see
+      * the passes of the next one.
+      */
+     private int numPasses;
+ 
+     /**
+      * Next coding pass to be claimed.
+      * <p>
+      * Passes are claimed in increasing order.
+      */
+     private AtomicInteger nextPass = new AtomicInteger(0);
+ 
+     /**
+      * Number of stripes finished by each pass.
+      * <p>
+      * Set to <code>Integer.MAX_VALUE</code> when a pass ends, also when it fails.
+      */
+     private AtomicIntegerArray progress;
+ 
+     /**
+      * Thread that decodes each pass.
+      * <p>
+      * Set before the pass waits for the previous one, which unparks it.
+      */
+     private AtomicReferenceArray<Thread> threads;
+ 
+     /**
+      * Counts the passes that have not ended yet.
+      * <p>
+      * Awaited by the calling thread.
+      */
+     private CountDownLatch finished;
+ 
+     /**
+      * First exception raised by a pass.
+      * <p>
+      * The passes claimed afterwards are skipped.
+      */
+     private AtomicReference<Exception> failure = new AtomicReference<Exception>();
+ 
+ 
+     /**
+      * Creates the pipeline of a code-block.
+      *
+      * @param stream stream from which the code-block is read
+      * @param passEnds end of the segment of each coding pass in the stream
+      * @param samples magnitudes of the code-block
+      * @param numPasses number of coding passes of the code-block
+      */
+     PassPipeline(ByteStream stream, int[] passEnds, int[] samples, int numPasses){
+       this.stream = stream;
+       this.passEnds = passEnds;
+       this.samples = samples;
+       this.numPasses = numPasses;
+       progress = new AtomicIntegerArray(numPasses);
+       threads = new AtomicReferenceArray<Thread>(numPasses);
+       finished = new CountDownLatch(numPasses);
+     }
+ 
+     /**
+      * Decodes the passes not claimed yet, one after the other.
+      */
+     public void run(){
+       for(int pass = nextPass.getAndIncrement(); pass < numPasses;
+         pass = nextPass.getAndIncrement()){
+         threads.set(pass, Thread.currentThread());
+         try{
+           if(failure.get() == null){
+             decodePass(pass);
+           }
+         }catch(Exception e){
+           failure.compareAndSet(null, e);
+         }finally{
+           progress.set(pass, Integer.MAX_VALUE);
+           wake(pass + 1);
+           finished.countDown();
+         }
+       }
+     }
+ 
+     /**
+      * Decodes a coding pass, waiting for the previous pass before each stripe.
+      *
+      * @param pass coding pass decoded
+      * @throws Exception when some problem manipulating the stream occurs
+      */
+     private void decodePass(int pass) throws Exception{
+       ArithmeticCoder coder = passCoders[pass];
+       coder.changeStream(stream);
+       coder.restartDecoding(pass > 0 ? passEnds[pass - 1]: 0, passEnds[pass]);
+       resetContexts(coder);
+       for(int stripe = 0; stripe < numStripes; stripe++){
+         if(pass > 0){
+           int needed = stripe + 2 < numStripes ? stripe + 2: numStripes;
+           //The progress is read after the thread is published, so no unpark is lost
+           while(progress.get(pass - 1) < needed){
+             LockSupport.park(this);
+           }
+         }
+         decodeStripe(coder, samples, pass, stripe);
+         progress.set(pass, stripe + 1);
+         wake(pass + 1);
+       }
+     }
+ 
+     /**
+      * Unparks the thread of a pass, if it has been claimed, after the previous pass progresses.
+      *
+      * @param pass coding pass woken
+      */
+     private void wake(int pass){
+       if(pass < numPasses){
+         Thread thread = threads.get(pass);
+         if(thread != null){
+           LockSupport.unpark(thread);
+         }
+       }
+     }
+   }
+ 
+   /**
+    * Encodes a stripe of the significance propagation pass of a bit plane.
+    *
+    * @param samples samples of the code-block
+    * @param bitPlane bit plane coded
+    * @param stripe stripe coded
+    */
+   private void encodeSignificanceStripe(int[] samples, int bitPlane, int stripe){
+     int[] state = this.state;
+     int[] significanceContexts = this.significanceContexts;
+     int[] batchBits = this.batchBits;
+     int[] batchContexts = this.batchContexts;
+     int y0 = stripe * 4;
+     int rows = height - y0 < 4 ? height - y0: 4;
+     int p = (stripe + 1) * stride + 1;
+     int left = significanceColumn(p - 1);
+     int center = significanceColumn(p);
+     int n = 0;
+     for(int x = 0; x < width; x++, p++){
+       int right = significanceColumn(p + 1);
+       int word = state[p];
+       int s = y0 * width + x;
+       for(int r = 0; r < rows; r++, s += width){
+         if(((word >> r) & 1) == 0){
+           int neighbourhood = ((left >> r) & 7) | (((center >> r) & 7) << 3) | (((right >> r) & 7) << 6);
+           if(neighbourhood != 0){
+             int sample = samples[s];
+             int bit = ((sample < 0 ? -sample: sample) >> bitPlane) & 1;
+             batchBits[n] = bit;
+             batchContexts[n++] = significanceContexts[neighbourhood];
+             if(bit != 0){
+               int signContext = signContext(p, word, left, center, right, r);
+               batchBits[n] = (sample < 0 ? 1: 0) ^ (signContext >> 5);
+               batchContexts[n++] = signContext & 0x1F;
+               word |= (1 << r) | ((sample < 0 ? 1: 0) << (NEGATIVE_SHIFT + r));
+               center |= 1 << (r + 1);
+             }
+             word |= 1 << (VISITED_SHIFT + r);
+           }
+         }
+       }
+       state[p] = word;
+       left = center;
+       center = right;
+     }
+     coder.encodeBitsContext(batchBits, batchContexts, n);
+   }
+ 
+   /**
+    * Encodes a stripe of the magnitude refinement pass of a bit plane.
+    *
+    * @param samples samples of the code-block
+    * @param bitPlane bit plane coded
+    * @param stripe stripe coded
+    */
+   private void encodeRefinementStripe(int[] samples, int bitPlane, int stripe){
+     int[] state = this.state;
+     int[] batchBits = this.batchBits;
+     int[] batchContexts = this.batchContexts;
+     int y0 = stripe * 4;
+     int rows = height - y0 < 4 ? height - y0: 4;
+     int p = (stripe + 1) * stride + 1;
+     int left = significanceColumn(p - 1);
+     int center = significanceColumn(p);
+     int n = 0;
+     for(int x = 0; x < width; x++, p++){
+       int right = significanceColumn(p + 1);
+       int word = state[p];
+       int s = y0 * width + x;
+       for(int r = 0; r < rows; r++, s += width){
+         if(((word >> r) & 0x101) == 1){
+           int sample = samples[s];
+           batchBits[n] = ((sample < 0 ? -sample: sample) >> bitPlane) & 1;
+           batchContexts[n++] = refinementContext(word, left, center, right, r);
+           word |= 1 << (REFINED_SHIFT + r);
+         }
+       }
+       state[p] = word;
+       left = center;
+       center = right;
+     }
+     coder.encodeBitsContext(batchBits, batchContexts, n);
+   }
+ 
+   /**
+    * Encodes a stripe of the cleanup pass of a bit plane.
+    *
+    * @param samples samples of the code-block
+    * @param bitPlane bit plane coded
+    * @param stripe stripe coded
+    */
+   private void encodeCleanupStripe(int[] samples, int bitPlane, int stripe){
+     int[] state = this.state;
+     int[] significanceContexts = this.significanceContexts;
+     int[] batchBits = this.batchBits;
+     int[] batchContexts = this.batchContexts;
+     int y0 = stripe * 4;
+     int rows = height - y0 < 4 ? height - y0: 4;
+     int p = (stripe + 1) * stride + 1;
+     int left = significanceColumn(p - 1);
+     int center = significanceColumn(p);
+     int n = 0;
+     for(int x = 0; x < width; x++, p++){
+       int right = significanceColumn(p + 1);
+       int word = state[p];
+       int s = y0 * width + x;
+       int r = 0;
+       if((rows == 4) && ((left | center | right) == 0)){
+         //Run-length mode
+         while((r < 4) && ((((samples[s] < 0 ? -samples[s]: samples[s]) >> bitPlane) & 1) == 0)){
+           r++;
+           s += width;
+         }
+         if(melRuns){
+           mel.encodeBit(r != 4);
+         }else{
+           batchBits[n] = r != 4 ? 1: 0;
+           batchContexts[n++] = CONTEXT_RUN;
+         }
+         if(r < 4){
+           batchBits[n] = (r >> 1) & 1;
+           batchContexts[n++] = CONTEXT_UNIFORM;
+           batchBits[n] = r & 1;
+           batchContexts[n++] = CONTEXT_UNIFORM;
+           int signContext = signContext(p, word, left, center, right, r);
+           batchBits[n] = (samples[s] < 0 ? 1: 0) ^ (signContext >> 5);
+           batchContexts[n++] = signContext & 0x1F;
+           word |= (1 << r) | ((samples[s] < 0 ? 1: 0) << (NEGATIVE_SHIFT + r));
+           center |= 1 << (r + 1);
+           r++;
+           s += width;
+         }
+       }
+       for(; r < rows; r++, s += width){
+         if(((word >> r) & 0x101) == 0){
+           int neighbourhood = ((left >> r) & 7) | (((center >> r) & 7) << 3) | (((right >> r) & 7) << 6);
+           int sample = samples[s];
+           int bit = ((sample < 0 ? -sample: sample) >> bitPlane) & 1;
+           batchBits[n] = bit;
+           batchContexts[n++] = significanceContexts[neighbourhood];
+           if(bit != 0){
+             int signContext = signContext(p, word, left, center, right, r);
+             batchBits[n] = (sample < 0 ? 1: 0) ^ (signContext >> 5);
+             batchContexts[n++] = signContext & 0x1F;
+             word |= (1 << r) | ((sample < 0 ? 1: 0) << (NEGATIVE_SHIFT + r));
+             center |= 1 << (r + 1);
+           }
+         }
+       }
+       state[p] = word & ~(0xF << VISITED_SHIFT);
+       left = center;
+       center = right;
+     }
+     coder.encodeBitsContext(batchBits, batchContexts, n);
+   }
+ 
+   /**
+    * Decodes a stripe of the significance propagation pass of a bit plane.
+    *
+    * @param coder coder from which the symbols are decoded
+    * @param samples magnitudes of the code-block decoded so far
+    * @param bitPlane bit plane decoded
+    * @param stripe stripe decoded
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   private void decodeSignificanceStripe(ArithmeticCoder coder, int[] samples, int bitPlane, int stripe) throws Exception{
+     int[] state = this.state;
+     int[] significanceContexts = this.significanceContexts;
+     int one = 1 << bitPlane;
+     int y0 = stripe * 4;
+     int rows = height - y0 < 4 ? height - y0: 4;
+     int p = (stripe + 1) * stride + 1;
+     int left = significanceColumn(p - 1);
+     int center = significanceColumn(p);
+     for(int x = 0; x < width; x++, p++){
+       int right = significanceColumn(p + 1);
+       int word = state[p];
+       int s = y0 * width + x;
+       for(int r = 0; r < rows; r++, s += width){
+         if(((word >> r) & 1) == 0){
+           int neighbourhood = ((left >> r) & 7) | (((center >> r) & 7) << 3) | (((right >> r) & 7) << 6);
+           if(neighbourhood != 0){
+             if(coder.decodeBitContext(significanceContexts[neighbourhood])){
+               int signContext = signContext(p, word, left, center, right, r);
+               int negative = (coder.decodeBitContext(signContext & 0x1F) ? 1: 0) ^ (signContext >> 5);
+               samples[s] |= one;
+               word |= (1 << r) | (negative << (NEGATIVE_SHIFT + r));
+               center |= 1 << (r + 1);
+             }
+             word |= 1 << (VISITED_SHIFT + r);
+           }
+         }
+       }
+       state[p] = word;
+       left = center;
+       center = right;
+     }
+   }
+ 
+   /**
+    * Decodes a stripe of the magnitude refinement pass of a bit plane.
+    *
+    * @param coder coder from which the symbols are decoded
+    * @param samples magnitudes of the code-block decoded so far
+    * @param bitPlane bit plane decoded
+    * @param stripe stripe decoded
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   private void decodeRefinementStripe(ArithmeticCoder coder, int[] samples, int bitPlane, int stripe) throws Exception{
+     int[] state = this.state;
+     int one = 1 << bitPlane;
+     int y0 = stripe * 4;
+     int rows = height - y0 < 4 ? height - y0: 4;
+     int p = (stripe + 1) * stride + 1;
+     int left = significanceColumn(p - 1);
+     int center = significanceColumn(p);
+     for(int x = 0; x < width; x++, p++){
+       int right = significanceColumn(p + 1);
+       int word = state[p];
+       int s = y0 * width + x;
+       for(int r = 0; r < rows; r++, s += width){
+         if(((word >> r) & 0x101) == 1){
+           if(coder.decodeBitContext(refinementContext(word, left, center, right, r))){
+             samples[s] |= one;
+           }
+           word |= 1 << (REFINED_SHIFT + r);
+         }
+       }
+       state[p] = word;
+       left = center;
+       center = right;
+     }
+   }
+ 
+   /**
+    * Decodes a stripe of the cleanup pass of a bit plane.
+    *
+    * @param coder coder from which the symbols are decoded
+    * @param samples magnitudes of the code-block decoded so far
+    * @param bitPlane bit plane decoded
+    * @param stripe stripe decoded
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   private void decodeCleanupStripe(ArithmeticCoder coder, int[] samples, int bitPlane, int stripe) throws Exception{
+     int[] state = this.state;
+     int[] significanceContexts = this.significanceContexts;
+     int one = 1 << bitPlane;
+     int y0 = stripe * 4;
+     int rows = height - y0 < 4 ? height - y0: 4;
+     int p = (stripe + 1) * stride + 1;
+     int left = significanceColumn(p - 1);
+     int center = significanceColumn(p);
+     for(int x = 0; x < width; x++, p++){
+       int right = significanceColumn(p + 1);
+       int word = state[p];
+       int s = y0 * width + x;
+       int r = 0;
+       if((rows == 4) && ((left | center | right) == 0)){
+         //Run-length mode
+         if(!(melRuns ? mel.decodeBit(): coder.decodeBitContext(CONTEXT_RUN))){
+           r = 4;
+         }else{
+           r = coder.decodeBitContext(CONTEXT_UNIFORM) ? 2: 0;
+           r |= coder.decodeBitContext(CONTEXT_UNIFORM) ? 1: 0;
+           s += r * width;
+           int signContext = signContext(p, word, left, center, right, r);
+           int negative = (coder.decodeBitContext(signContext & 0x1F) ? 1: 0) ^ (signContext >> 5);
+           samples[s] |= one;
+           word |= (1 << r) | (negative << (NEGATIVE_SHIFT + r));
+           center |= 1 << (r + 1);
+           r++;
+           s += width;
+         }
+       }
+       for(; r < rows; r++, s += width){
+         if(((word >> r) & 0x101) == 0){
+           int neighbourhood = ((left >> r) & 7) | (((center >> r) & 7) << 3) | (((right >> r) & 7) << 6);
+           if(coder.decodeBitContext(significanceContexts[neighbourhood])){
+             int signContext = signContext(p, word, left, center, right, r);
+             int negative = (coder.decodeBitContext(signContext & 0x1F) ? 1: 0) ^ (signContext >> 5);
+             samples[s] |= one;
+             word |= (1 << r) | (negative << (NEGATIVE_SHIFT + r));
+             center |= 1 << (r + 1);
+           }
+         }
+       }
+       state[p] = word & ~(0xF << VISITED_SHIFT);
+       left = center;
+       center = right;
+     }
+   }
+ 
+   /**
+    * Negates the decoded magnitudes of the negative samples.
+    *
+    * @param samples magnitudes of the code-block
+    */
+   private void applySigns(int[] samples){
+     for(int stripe = 0; stripe < numStripes; stripe++){
+       int y0 = stripe * 4;
+       int rows = height - y0 < 4 ? height - y0: 4;
+       int p = (stripe + 1) * stride + 1;
+       for(int x = 0; x < width; x++, p++){
+         int negative = state[p] >> NEGATIVE_SHIFT;
+         for(int r = 0, s = y0 * width + x; r < rows; r++, s += width){
+           if(((negative >> r) & 1) != 0){
+             samples[s] = -samples[s];
+           }
+         }
+       }
+     }
+   }
+ 
+   /**
+    * Gathers the significance of a stripe column together with the significance of the last row
+    * of the stripe above and of the first row of the stripe below.
+    *
+    * @param p position of the word of the stripe column
+    * @return 6-bit value with, from right to left, the row above the stripe, rows 0 to 3 of the
+    * stripe, and the row below the stripe (0 with <code>OPTION_CAUSAL</code>)
+    */
+   private int significanceColumn(int p){
+     return(((state[p - stride] >> 3) & 1) | ((state[p] & 0xF) << 1) | ((state[p + stride] & belowMask) << 5));
+   }
+ 
+   /**
+    * Gathers the sign of a stripe column together with the sign of the last row of the stripe
+    * above and of the first row of the stripe below.
+    *
+    * @param p position of the word of the stripe column
+    * @param word current state word of the stripe column
+    * @return 6-bit value with the negative sign bits arranged as in <code>significanceColumn</code>
+    */
+   private int negativeColumn(int p, int word){
+     return(((state[p - stride] >> (NEGATIVE_SHIFT + 3)) & 1) | (((word >> NEGATIVE_SHIFT) & 0xF) << 1)
+       | (((state[p + stride] >> NEGATIVE_SHIFT) & 1) << 5));
+   }
+ 
+   /**
+    * Computes the sign context of a sample from the significance and sign of its horizontal and
+    * vertical neighbours.
+    *
+    * @param p position of the word of the stripe column
+    * @param word current state word of the stripe column
+    * @param left significance of the column at the left (see <code>significanceColumn</code>)
+    * @param center significance of the column of the sample
+    * @param right significance of the column at the right
+    * @param r row of the sample in the stripe
+    * @return entry of <code>SIGN_CONTEXTS</code>
+    */
+   private int signContext(int p, int word, int left, int center, int right, int r){
+     int negativeLeft = negativeColumn(p - 1, state[p - 1]);
+     int negativeCenter = negativeColumn(p, word);
+     int negativeRight = negativeColumn(p + 1, state[p + 1]);
+     int significance = ((center >> r) & 5) | ((left >> r) & 2) | (((right >> r) & 2) << 2);
+     int negative = ((negativeCenter >> r) & 5) | ((negativeLeft >> r) & 2) | (((negativeRight >> r) & 2) << 2);
+     return(SIGN_CONTEXTS[significance | (negative << 4)]);
+   }
+ 
+   /**
+    * Computes the magnitude refinement context of a sample.
+    *
+    * @param word state word of the stripe column
+    * @param left significance of the column at the left (see <code>significanceColumn</code>)
+    * @param center significance of the column of the sample
+    * @param right significance of the column at the right
+    * @param r row of the sample in the stripe
+    * @return context in the range [14, 16]
+    */
+   private static int refinementContext(int word, int left, int center, int right, int r){
+     if(((word >> (REFINED_SHIFT + r)) & 1) != 0){
+       return(CONTEXT_REFINEMENT + 2);
+     }
+     return(((((left | right) >> r) & 7) | ((center >> r) & 5)) != 0 ? CONTEXT_REFINEMENT + 1: CONTEXT_REFINEMENT);
+   }
+ 
+   /**
+    * Sets the dimensions of the current code-block and clears its state.
+    *
+    * @param width width of the code-block
+    * @param height height of the code-block
+    * @param subband subband to which the code-block belongs
+    */
+   private void prepare(int width, int height, int subband){
+     this.width = width;
+     this.height = height;
+     this.numStripes = (height + 3) / 4;
+     this.stride = width + 2;
+     this.significanceContexts = SIGNIFICANCE_CONTEXTS[subband];
+     int numWords = (numStripes + 2) * stride;
+     if(state.length < numWords){
+       state = new int[numWords];
+     }else{
+       for(int p = 0; p < numWords; p++){
+         state[p] = 0;
+       }
+     }
+     if(batchBits.length < MAX_SYMBOLS_PER_COLUMN * width){
+       batchBits = new int[MAX_SYMBOLS_PER_COLUMN * width];
+       batchContexts = new int[MAX_SYMBOLS_PER_COLUMN * width];
+     }
+   }
+ 
+   /**
+    * Resets the contexts to the initial states defined in the standard.
+    *
+    * @param coder coder whose contexts are reset
+    */
+   private void resetContexts(ArithmeticCoder coder){
+     coder.reset();
+     coder.setContextState(0, 4, 0);
+     coder.setContextState(CONTEXT_RUN, 3, 0);
+     coder.setContextState(CONTEXT_UNIFORM, 46, 0);
+   }
+ 
+   /**
+    * Builds the significance contexts of a subband for all the neighbourhoods.
+    *
+    * @param subband SUBBAND_LL, SUBBAND_HL, SUBBAND_LH, or SUBBAND_HH
+    * @return array of 512 contexts (see <code>SIGNIFICANCE_CONTEXTS</code>)
+    */
+   private static int[] buildSignificanceContexts(int subband){
+     int[] contexts = new int[512];
+     for(int neighbourhood = 0; neighbourhood < 512; neighbourhood++){
+       int h = ((neighbourhood >> 1) & 1) + ((neighbourhood >> 7) & 1);
+       int v = ((neighbourhood >> 3) & 1) + ((neighbourhood >> 5) & 1);
+       int d = Integer.bitCount(neighbourhood & 0x145);
+       if(subband == SUBBAND_HL){
+         int tmp = h;
+         h = v;
+         v = tmp;
+       }
+       int context;
+       if(subband == SUBBAND_HH){
+         int hv = h + v;
+         if(d >= 3){
+           context = 8;
+         }else if(d == 2){
+           context = hv >= 1 ? 7: 6;
+         }else if(d == 1){
+           context = hv >= 2 ? 5: (hv == 1 ? 4: 3);
+         }else{
+           context = hv >= 2 ? 2: hv;
+         }
+       }else{
+         if(h == 2){
+           context = 8;
+         }else if(h == 1){
+           context = v >= 1 ? 7: (d >= 1 ? 6: 5);
+         }else if(v >= 1){
+           context = v == 2 ? 4: 3;
+         }else{
+           context = d >= 2 ? 2: d;
+         }
+       }
+       contexts[neighbourhood] = context;
+     }
+     return(contexts);
+   }
+ 
+   /**
+    * Builds the sign contexts and predictions for all the patterns of the horizontal and
+    * vertical neighbours.
+    *
+    * @return array of 256 entries (see <code>SIGN_CONTEXTS</code>)
+    */
+   private static int[] buildSignContexts(){
+     int[] contexts = new int[256];
+     for(int pattern = 0; pattern < 256; pattern++){
+       int h = contribution(pattern, 1) + contribution(pattern, 3);
+       int v = contribution(pattern, 0) + contribution(pattern, 2);
+       h = h > 1 ? 1: (h < -1 ? -1: h);
+       v = v > 1 ? 1: (v < -1 ? -1: v);
+       int context;
+       int prediction = 0;
+       if(h == 0){
+         context = v == 0 ? 9: 10;
+         prediction = v < 0 ? 1: 0;
+       }else{
+         context = 12 + h * v;
+         prediction = h < 0 ? 1: 0;
+       }
+       contexts[pattern] = context | (prediction << 5);
+     }
+     return(contexts);
+   }
+ 
+   /**
+    * Computes the contribution of a neighbour to the sign context.
+    *
+    * @param pattern significance bits of the N, W, S, E neighbours followed by their sign bits
+    * @param neighbour 0 for N, 1 for W, 2 for S, and 3 for E
+    * @return 1 when the neighbour is significant and positive, -1 when it is significant and
+    * negative, and 0 otherwise
+    */
+   private static int contribution(int pattern, int neighbour){
+     if(((pattern >> neighbour) & 1) == 0){
+       return(0);
+     }
+     return(((pattern >> (neighbour + 4)) & 1) != 0 ? -1: 1);
+   }
+ }
\ No newline at end of file
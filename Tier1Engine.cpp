@@ -0,0 +1,233 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ import java.util.Arrays;
+ import java.util.concurrent.ForkJoinPool;
+ import java.util.concurrent.RecursiveAction;
+ import streams.ByteStream;
+ 
+ 
+ /**
+  * This class encodes or decodes many independent code-blocks in parallel. The code-blocks are
+  * distributed among the threads of a work-stealing pool: the range of code-blocks is split
+  * recursively and idle threads steal the pending halves of busy threads, which balances the very
+  * different costs of the code-blocks. Each thread keeps its own block coder (a
+  * <code>Tier1Coder</code> or an <code>HTBlockCoder</code>, with its own buffers), which is reused
+  * for all the code-blocks that it codes.<br>
+  *
+  * Each code-block is coded to its own stream by a single thread, so the result is the same
+  * regardless of the number of threads and of the order in which code-blocks are coded.<br>
+  *
+  * Multithreading support: the methods of an object must be called by a single thread at a time.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class Tier1Engine{
+ 
+   /**
+    * Block coder based on the <code>ArithmeticCoder</code> (<code>Tier1Coder</code>).
+    */
+   public static final int CODER_MQ = 0;
+ 
+   /**
+    * High-throughput block coder (<code>HTBlockCoder</code>).
+    */
+   public static final int CODER_HT = 1;
+ 
+   /**
+    * Pool of threads that code the code-blocks.
+    * <p>
+    * Created when the object is instantiated.
+    */
+   private ForkJoinPool pool;
+ 
+   /**
+    * Block coder of each thread of the pool.
+    * <p>
+    * Created the first time that a thread codes a code-block.
+    */
+   private ThreadLocal<BlockCoder> coders;
+ 
+ 
+   /**
+    * Creates the pool of threads, which code the code-blocks with the <code>Tier1Coder</code>.
+    *
+    * @param numThreads number of threads employed to code the code-blocks
+    */
+   public Tier1Engine(int numThreads){
+     this(numThreads, CODER_MQ);
+   }
+ 
+   /**
+    * Creates the pool of threads.
+    *
+    * @param numThreads number of threads employed to code the code-blocks
+    * @param blockCoder block coder employed, either <code>CODER_MQ</code> or <code>CODER_HT</code>.
+    * The same block coder must be employed to encode and to decode the code-blocks
+    */
+   public Tier1Engine(int numThreads, final int blockCoder){
+     pool = new ForkJoinPool(numThreads);
+     coders = new ThreadLocal<BlockCoder>(){
+       protected BlockCoder initialValue(){
+         if(blockCoder == CODER_HT){
+           return(new HTBlockCoder());
+         }
+         return(new Tier1Coder());
+       }
+     };
+   }
+ 
+   /**
+    * Encodes a set of code-blocks. For each code-block, the stream (created when it is null),
+    * the number of bit planes, the number of passes and the end of the passes are set.
+    *
+    * @param blocks code-blocks to encode
+    * @throws Exception when some problem manipulating the streams occurs
+    */
+   public void encode(CodeBlock[] blocks) throws Exception{
+     run(new CodingTask(blocks, 0, blocks.length, true));
+   }
+ 
+   /**
+    * Decodes a set of code-blocks. For each code-block, the samples are set from the stream, the
+    * number of bit planes and the number of passes.
+    *
+    * @param blocks code-blocks to decode
+    * @throws Exception when some problem manipulating the streams occurs
+    */
+   public void decode(CodeBlock[] blocks) throws Exception{
+     run(new CodingTask(blocks, 0, blocks.length, false));
+   }
+ 
+   /**
+    * Terminates the threads of the pool. The object cannot be employed afterwards.
+    */
+   public void shutdown(){
+     pool.shutdown();
+   }
+ 
+   /**
+    * Runs a task in the pool, forwarding the exceptions raised while coding. The exception of a
+    * code-block is wrapped by <code>CodingTask</code> and, when the task runs in another thread,
+    * wrapped again by the pool, so the causes are followed until the first checked exception.
+    *
+    * @param task task to run
+    * @throws Exception when some problem manipulating the streams occurs
+    */
+   private void run(CodingTask task) throws Exception{
+     try{
+       pool.invoke(task);
+     }catch(RuntimeException e){
+       Throwable cause = e;
+       while((cause instanceof RuntimeException) && (cause.getCause() != null)){
+         cause = cause.getCause();
+       }
+       if((cause instanceof Exception) && !(cause instanceof RuntimeException)){
+         throw (Exception) cause;
+       }
+       throw e;
+     }
+   }
+ 
+   /**
+    * Codes a range of code-blocks, splitting it in two halves that can be stolen by other threads
+    * when it contains more than one code-block.
+    */
+   private final class CodingTask extends RecursiveAction{
+ 
+     /**
+      * Code-blocks to code.
+      * <p>
+      * Shared by all the tasks.
+      */
+     private CodeBlock[] blocks;
+ 
+     /**
+      * First code-block of the range.
+      * <p>
+      * Inclusive.
+      */
+     private int begin;
+ 
+     /**
+      * Last code-block of the range.
+      * <p>
+      * Exclusive.
+      */
+     private int end;
+ 
+     /**
+      * Indicates whether the code-blocks are encoded or decoded.
+      * <p>
+      * True when encoding.
+      */
+     private boolean encoding;
+ 
+ 
+     /**
+      * Creates the task.
+      *
+      * @param blocks code-blocks to code
+      * @param begin first code-block of the range (inclusive)
+      * @param end last code-block of the range (exclusive)
+      * @param encoding true to encode, false to decode
+      */
+     CodingTask(CodeBlock[] blocks, int begin, int end, boolean encoding){
+       this.blocks = blocks;
+       this.begin = begin;
+       this.end = end;
+       this.encoding = encoding;
+     }
+ 
+     /**
+      * Codes the range of code-blocks.
+      */
+     protected void compute(){
+       if(end - begin > 1){
+         int middle = (begin + end) >>> 1;
+         invokeAll(new CodingTask(blocks, begin, middle, encoding),
+           new CodingTask(blocks, middle, end, encoding));
+         return;
+       }
+       if(end > begin){
+         try{
+           code(blocks[begin]);
+         }catch(Exception e){
+           throw new RuntimeException(e);
+         }
+       }
+     }
+ 
+     /**
+      * Codes a code-block with the coder of the current thread.
+      *
+      * @param block code-block to code
+      * @throws Exception when some problem manipulating the stream occurs
+      */
+     private void code(CodeBlock block) throws Exception{
+       BlockCoder coder = coders.get();
+       coder.setOptions(block.options);
+       if(encoding){
+         if(block.stream == null){
+           block.stream = new ByteStream();
+         }
+         coder.encode(block.samples, block.width, block.height, block.subband, block.stream);
+         block.numBitPlanes = coder.getNumBitPlanes();
+         block.numPasses = coder.getNumPasses();
+         block.passEnds = Arrays.copyOf(coder.getPassEnds(), block.numPasses);
+       }else{
+         coder.decode(block.stream, block.width, block.height, block.subband, block.numBitPlanes,
+           block.numPasses, block.passEnds, block.samples);
+       }
+     }
+   }
+ }
\ No newline at end of file
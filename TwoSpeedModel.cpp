@@ -0,0 +1,195 @@
+ /**
+  * Copyright (C) 2013 - Francesc Auli-Llinas
+  *
+  * This program is distributed under the BOI License.
+  * This program is distributed in the hope that it will be useful, but without any
+  * warranty; without even the implied warranty of merchantability or fitness for a particular purpose.
+  * You should have received a copy of the BOI License along with this program. If not,
+  * see <http://www.deic.uab.cat/~francesc/software/license/>.
+  */
+ package coders;
+ 
+ 
+ /**
+  * This class implements an adaptive context model whose probabilities are coded with
+  * <code>encodeBitProb</code> and <code>decodeBitProb</code>, as an alternative to the state
+  * machine of the MQ coder. Each context keeps two estimates of the probability of the symbol 0 in
+  * 15 bits, updated as exponential-decay counters that move 1/2^rate of the way towards 0 or 2^15
+  * after each bit: a fast one that follows the changes of the statistics and a slow one that is
+  * precise once they are stable. The probability coded is the mean of both. All the arithmetic is
+  * integer, including the conversion to the probabilities of the MQ coder.<br>
+  *
+  * Usage: once the object is created, each bit is coded with <code>encodeBit</code> or
+  * <code>decodeBit</code>, which also update the context. Any <code>BinaryCoder</code> can be
+  * employed.<br>
+  *
+  * Multithreading support: the object must be created and manipulated by a single thread. There
+  * can be many objects of this class running simultaneously as long as a single thread manipulates
+  * each object.<br>
+  *
+  * @author Francesc Auli-Llinas
+  * @version 1.0
+  */
+ public final class TwoSpeedModel{
+ 
+   /**
+    * Number of bits of the probabilities.
+    * <p>
+    * Probabilities are in the range (0, 2^PROB_BITS).
+    */
+   public static final int PROB_BITS = 15;
+ 
+   /**
+    * Probability 1 in fixed point.
+    * <p>
+    * 2^PROB_BITS.
+    */
+   private static final int PROB_ONE = 1 << PROB_BITS;
+ 
+   /**
+    * Default adaptation rate of the fast counter.
+    * <p>
+    * Each update moves the probability 1/16 of the way.
+    */
+   public static final int DEFAULT_FAST_RATE = 4;
+ 
+   /**
+    * Default adaptation rate of the slow counter.
+    * <p>
+    * Each update moves the probability 1/128 of the way.
+    */
+   public static final int DEFAULT_SLOW_RATE = 7;
+ 
+   /**
+    * Number of contexts.
+    * <p>
+    * Set when the class is instantiated.
+    */
+   private int numContexts;
+ 
+   /**
+    * Adaptation rate (shift) of the fast counter.
+    * <p>
+    * Lower than <code>slowRate</code>.
+    */
+   private int fastRate;
+ 
+   /**
+    * Adaptation rate (shift) of the slow counter.
+    * <p>
+    * At most 14.
+    */
+   private int slowRate;
+ 
+   /**
+    * Fast estimate of the probability of the symbol 0 of each context.
+    * <p>
+    * In the range (0, 2^PROB_BITS).
+    */
+   private int[] fastProbs;
+ 
+   /**
+    * Slow estimate of the probability of the symbol 0 of each context.
+    * <p>
+    * In the range (0, 2^PROB_BITS).
+    */
+   private int[] slowProbs;
+ 
+ 
+   /**
+    * Creates the model with the default adaptation rates and all contexts equiprobable.
+    *
+    * @param numContexts number of contexts
+    */
+   public TwoSpeedModel(int numContexts){
+     this(numContexts, DEFAULT_FAST_RATE, DEFAULT_SLOW_RATE);
+   }
+ 
+   /**
+    * Creates the model with all contexts equiprobable.
+    *
+    * @param numContexts number of contexts
+    * @param fastRate adaptation rate of the fast counter, in the range [1, slowRate - 1]
+    * @param slowRate adaptation rate of the slow counter, in the range [fastRate + 1, 14]
+    */
+   public TwoSpeedModel(int numContexts, int fastRate, int slowRate){
+     this.numContexts = numContexts;
+     this.fastRate = fastRate;
+     this.slowRate = slowRate;
+     fastProbs = new int[numContexts];
+     slowProbs = new int[numContexts];
+     reset();
+   }
+ 
+   /**
+    * Sets all contexts equiprobable.
+    */
+   public void reset(){
+     for(int c = 0; c < numContexts; c++){
+       fastProbs[c] = PROB_ONE >> 1;
+       slowProbs[c] = PROB_ONE >> 1;
+     }
+   }
+ 
+   /**
+    * Gets the probability of the symbol 0 of a context.
+    *
+    * @param context context of the symbol
+    * @return probability in PROB_BITS bits, in the range (0, 2^PROB_BITS)
+    */
+   public int getProbability(int context){
+     return((fastProbs[context] + slowProbs[context]) >> 1);
+   }
+ 
+   /**
+    * Gets the probability of the symbol 0 of a context as the integer of the MQ coder.
+    *
+    * @param context context of the symbol
+    * @return probability as given by <code>ArithmeticCoder.prob0ToMQ</code>
+    */
+   public int getMQProbability(int context){
+     return(ArithmeticCoder.prob15ToMQ(getProbability(context)));
+   }
+ 
+   /**
+    * Updates a context after coding a bit.
+    *
+    * @param bit bit coded
+    * @param context context of the bit
+    */
+   public void update(boolean bit, int context){
+     if(bit){
+       fastProbs[context] -= fastProbs[context] >> fastRate;
+       slowProbs[context] -= slowProbs[context] >> slowRate;
+     }else{
+       fastProbs[context] += (PROB_ONE - fastProbs[context]) >> fastRate;
+       slowProbs[context] += (PROB_ONE - slowProbs[context]) >> slowRate;
+     }
+   }
+ 
+   /**
+    * Encodes a bit with the probability of a context and updates it.
+    *
+    * @param coder coder employed
+    * @param bit input
+    * @param context context of the bit
+    */
+   public void encodeBit(BinaryCoder coder, boolean bit, int context){
+     coder.encodeBitProb(bit, getMQProbability(context));
+     update(bit, context);
+   }
+ 
+   /**
+    * Decodes a bit with the probability of a context and updates it.
+    *
+    * @param coder coder employed
+    * @param context context of the bit
+    * @return output bit
+    * @throws Exception when some problem manipulating the stream occurs
+    */
+   public boolean decodeBit(BinaryCoder coder, int context) throws Exception{
+     boolean bit = coder.decodeBitProb(getMQProbability(context));
+     update(bit, context);
+     return(bit);
+   }
+ }
\ No newline at end of file